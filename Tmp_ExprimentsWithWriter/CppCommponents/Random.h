@@ -2,6 +2,9 @@
 
 #include <vector>
 #include <random>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
 
 namespace Random
 {
@@ -23,6 +26,15 @@ namespace Random
     		engine().seed(seed);
 	}	
 
+	// Derives the seed of one stream (e.g. one generated variant) from a run seed, so each
+	// stream is reproducible on its own no matter which thread runs it (splitmix64 finalizer)
+	inline unsigned int derive_seed(uint64_t run_seed, uint64_t index) {
+		uint64_t z = run_seed + (index + 1) * 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return static_cast<unsigned int>(z ^ (z >> 31));
+	}
+
 	// === Existing-like Functions (Modernized) ===
 
 	// Generates a random float in [0.0, 1.0]
@@ -1,12 +1,24 @@
 #pragma once
 
-#include "CppCommponents/Random.h"
+#include "ShaderGenerator.h"
+#include "ShaderCache.h"
 
 #include <iostream>
-
-#include "Writer.h"
-
+#include <string>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
 #include <vector>
+#include <atomic>
+#include <ctime>
+#include <optional>
+#include <fstream>
+#include <iterator>
+#include <cctype>
+#include <stdexcept>
+#include <cstdint>
 
 #include <chrono>
 #include <thread>
@@ -15,732 +27,457 @@ using namespace std::chrono_literals;
 
 
 
-void generate_shader()
+// Generation runs ahead of publishing: a worker keeps a bounded queue of finished variants
+// while the current one is in use, and every cadence tick main() publishes the oldest.
+// A slow generation then only delays a tick instead of stretching every cycle.
+struct PipelineConfig
 {
-	
+	std::chrono::milliseconds cadence = 4000ms;
+	size_t queue_depth = 2;   // variants generated ahead of the one being published
+	size_t runs = 0;          // variants to publish before exiting, 0 = forever
+	std::filesystem::path output = "C:/Users/Cosmos/Documents/GitHub/Tmp/Tmp/shaders/vertex_9.glsl";
+};
 
-	Writer_::Writer w;
+struct GeneratedShader
+{
+	Writer_::Writer writer;
+	size_t index = 0;
+	std::chrono::steady_clock::duration latency{};   // spent in write_vertex_shader
+	size_t sections_reused = 0;
+};
+
+// Bounded producer/consumer queue: push() waits while it is full, pop() while it is empty.
+// After stop() both return false (pop() still drains what is queued).
+class ShaderQueue
+{
+public:
+	explicit ShaderQueue(size_t depth) : depth_(depth == 0 ? 1 : depth) {}
 
-	// Generate Header
+	bool push(GeneratedShader&& shader)
 	{
-		w.line("#version 450 core");
-		w.line("layout(location = 0) in vec3 aPos;");
-		w.line("layout(location = 1) in vec2 aTexCoord;");
-		w.blank();
-
-
-		w.comment("outputs to fragment");
-		w.line("out vec2 TexCoord;");
-		w.line("out vec3 color_vs;");
-		w.line("out vec3 vWorldPos;");
-		w.line("out vec3 vNormal;");
-		w.blank();
-
-		w.comment("uniforms");
-		w.line("uniform mat4 model;       // can be identity");
-		w.line("uniform mat4 view;");
-		w.line("uniform mat4 projection;");
-		w.line("uniform ivec3 uGrid;      // number of instances along X,Y,Z (instanceCount = X*Y*Z)");
-		w.line("uniform float uSpacing;   // distance between grid cells"); // we are not using this
-		w.line("uniform vec3  uOrigin;    // base world offset");
-		w.line("uniform vec3  uScaleMin;  // min scale per axis");
-		w.line("uniform vec3  uScaleMax;  // max scale per axis");
-		w.line("uniform float uTime;      // time (seconds)");
-		w.line("uniform float uRotSpeed;  // radians/sec");
-		w.line("uniform uint  uSeed;      // global random seed");
-		w.blank();
-		w.line("uniform uint uDrawcallNumber;");
-		w.line("uniform vec3 uCameraPos;");
-		w.line("uniform float u0, u1, u2, u3, u4, u5, u6, u7, u8, u9;");
-		w.blank();
-
-		w.comment("// ---------- Constants & tiny helpers ----------");
-		w.line("const float PI = 3.1415926535897932384626433832795;");
-		w.line("const float TAU = 6.2831853071795864769252867665590;");
-		w.blank();
-
-		w.line("float saturate(float x) { return clamp(x, 0.0, 1.0); }");
-		w.blank();
-
-		w.lines(R"GLSL(
-uint pcg_hash(uint x) {
-    x = x * 747796405u + 2891336453u;
-    x = ((x >> ((x >> 28u) + 4u)) ^ x) * 277803737u;
-    x = (x >> 22u) ^ x;
-    return x;
-}
-)GLSL", {});
-		w.blank();
-
-		w.line("float rand01(inout uint s) { s = pcg_hash(s); return float(s) * (1.0 / 4294967295.0); }");
-		w.blank();
-
-		w.lines(R"GLSL(
-vec3 spherical01(float r, float theta01, float phi01) {
-    float theta = theta01 * TAU; // azimuth
-    float phi = phi01 * PI;   // polar
-    float sphi = sin(phi);
-    return vec3(r * sphi * cos(theta), r * cos(phi), r * sphi * sin(theta));
-}
-)GLSL", {});
-		w.blank();
-
-		w.lines(R"GLSL(
-mat3 axisAngleToMat3(vec3 axis, float a) {
-    float c = cos(a), s = sin(a);
-    vec3 t = (1.0 - c) * axis;
-    return mat3(
-        t.x * axis.x + c, t.x * axis.y - s * axis.z, t.x * axis.z + s * axis.y,
-        t.y * axis.x + s * axis.z, t.y * axis.y + c, t.y * axis.z - s * axis.x,
-        t.z * axis.x - s * axis.y, t.z * axis.y + s * axis.x, t.z * axis.z + c
-    );
-}
-)GLSL", {});
-		w.blank();
-
-		w.lines(R"GLSL(
-// Axis-aligned cube face normal from aPos (local space)
-vec3 localCubeFaceNormal(vec3 p) {
-    vec3 ap = abs(p);
-    if (ap.x >= ap.y && ap.x >= ap.z) return vec3(sign(p.x), 0.0, 0.0);
-    if (ap.y >= ap.x && ap.y >= ap.z) return vec3(0.0, sign(p.y), 0.0);
-    return vec3(0.0, 0.0, sign(p.z));
-}
-)GLSL", {});
-		w.blank();
+		std::unique_lock lock(mutex_);
+		not_full_.wait(lock, [&] { return stopped_ || queue_.size() < depth_; });
+		if (stopped_) return false;
+		queue_.push_back(std::move(shader));
+		not_empty_.notify_one();
+		return true;
 	}
 
-	
-	// The periodic functions
+	bool pop(GeneratedShader& out)
 	{
-		w.lines(R"GLSL(
-// 0 to 1
-float f_periodic_0(float x)
-{
-    return 2.0 * abs(fract(x + 0.5) - 0.5);
-}
+		std::unique_lock lock(mutex_);
+		not_empty_.wait(lock, [&] { return stopped_ || !queue_.empty(); });
+		if (queue_.empty()) return false;
+		out = std::move(queue_.front());
+		queue_.pop_front();
+		not_full_.notify_one();
+		return true;
+	}
 
-// Square Wave 
-float f_periodic_1(float x)
-{
-    return  floor(x) - floor(x - 0.5);
-}
+	void stop()
+	{
+		{
+			std::lock_guard lock(mutex_);
+			stopped_ = true;
+		}
+		not_full_.notify_all();
+		not_empty_.notify_all();
+	}
 
-// The Bouncing Ball (Parabolic Arches)
-float f_periodic_2(float x)
-{
-    return 4 * fract(x) * (1 - fract(x));
-}
+	size_t size()
+	{
+		std::lock_guard lock(mutex_);
+		return queue_.size();
+	}
 
-float f_periodic_3(float x)
+private:
+	std::mutex mutex_;
+	std::condition_variable not_full_;
+	std::condition_variable not_empty_;
+	std::deque<GeneratedShader> queue_;
+	size_t depth_;
+	bool stopped_ = false;
+};
+
+// One variant, timed. sections carries the fixed parts of the shader from one run to the
+// next; it belongs to the generating thread.
+inline GeneratedShader generate_shader(Writer_::SectionCache& sections, size_t index)
 {
-    return exp(-30 * ((fract(x + 0.5) - 0.5) * (fract(x + 0.5) - 0.5)));
-}
+	GeneratedShader shader;
+	shader.index = index;
 
-float f_periodic_4(float x)
-{
-    return abs(0.7 * cos(2 * PI * x) + 0.3 * cos(6 * PI * x)) * (-1.0) + 1.0;
-}
+	const size_t hitsBefore = sections.stats().hits;
+	const auto start = std::chrono::steady_clock::now();
 
-float f_periodic_5(float x)
-{ 
-    return 1.0 - abs(round(10 * fract(x)) / 10 - 0.5) * 2.0;
-}
+	write_vertex_shader(shader.writer, &sections);
 
-float f_periodic_6(float x)
-{
-    return sqrt(4 * fract(x) * (1 - fract(x)));
+	shader.latency = std::chrono::steady_clock::now() - start;
+	shader.sections_reused = sections.stats().hits - hitsBefore;
+	return shader;
 }
 
-float f_periodic_7(float x)
+// Only rewrites the file when the text changed, through a temp file renamed over it, so the
+// hot-reloading renderer never recompiles an identical or half-written shader
+inline Writer_::Writer::SaveResult publish_shader(const GeneratedShader& shader, const std::filesystem::path& output)
 {
-    return sin(5 * PI * fract(x)) * (1 - fract(x));
-}
+	Writer_::Writer::SaveResult result = shader.writer.save_if_changed(output);
 
-// 1) Raised-cosine (Hann) arch  smooth & band-limited-ish
-float f_periodic_8(float x)
-{
-    return 0.5 - 0.5 * cos(TAU * x);               // 0 at integers, 1 at half-integers
+	if constexpr (Writer_::Writer::Metrics::enabled)
+	{
+		std::cout << shader.writer.metrics().to_json() << "\n";
+	}
+
+	return result;
 }
 
-float f_periodic_9(float x)
+// Offline exploration: variants fanned out over a pool of threads, one file each. Every
+// variant seeds its thread's engine from (seed, index), so variant i is the same file
+// whatever the thread count or scheduling was.
+struct BatchConfig
+{
+	size_t variants = 0;      // 0 = run the publishing pipeline instead
+	uint64_t seed = static_cast<uint64_t>(std::time(nullptr));
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	std::filesystem::path output_dir = "C:/Users/Cosmos/Documents/GitHub/Tmp/Tmp/shaders/batch";
+	VertexShaderParams params;
+
+	// Variants already generated for the same (seed, params) are read back from here instead
+	std::filesystem::path cache_dir;   // empty = no cache
+	uint64_t cache_bytes = 256ull << 20;
+};
+
+// Content address of one variant: the engine seed it is generated from plus everything else
+// that decides its text
+inline uint64_t shader_cache_key(unsigned seed, const VertexShaderParams& params)
 {
-    return pow(2.0 * abs(fract(x + 0.5) - 0.5), 1.5);
+	return Writer_::SectionCache::hash_inputs(VertexShaderParams::version, seed, params.wave_count, params.uniform_waves, params.optimize_expressions);
 }
 
-float f_periodic_10(float x)
+struct BatchResult
+{
+	size_t written = 0;
+	size_t unchanged = 0;
+	size_t failed = 0;
+	std::chrono::steady_clock::duration elapsed{};
+	ShaderDiskCache::Stats cache;
+	Expr::Report expressions;   // over the variants actually generated (not read from the cache)
+};
+
+inline std::filesystem::path batch_variant_path(const BatchConfig& config, size_t index)
 {
-    return (abs(1.0 / (1.0 + exp(-6.0 * sin(TAU * x))) - 0.5)) * 2.0 * 2.0 * abs(fract(x + 0.5) - 0.5);
+	return config.output_dir / ("vertex_" + std::to_string(index) + ".glsl");
 }
 
-float f_periodic_11(float x)
+// With params.uniform_waves every variant shares this shader and only its WaveBlock differs
+inline std::filesystem::path batch_uniform_shader_path(const BatchConfig& config)
 {
-    return fract(x) * fract(x) * (3.0 - 2.0 * fract(x)) * 2.0 * abs(fract(x + 0.5) - 0.5) * 1.9;
+	return config.output_dir / "vertex_uniform_waves.glsl";
 }
 
-float f_adjust_to_two_pi(float x)
+inline std::filesystem::path batch_wave_block_path(const BatchConfig& config, size_t index)
 {
-    return x * (1.0 / TAU);
+	return config.output_dir / ("waves_" + std::to_string(index) + ".bin");
 }
-)GLSL", {});
-		w.blank();
-	}
-
-	
-
 
+// save_if_changed for a packed uniform buffer
+inline Writer_::Writer::SaveResult save_blob_if_changed(const std::filesystem::path& path, const std::vector<unsigned char>& blob)
+{
 	{
-		w.blank();
-		w.comment("wave functions");
-
-		/*
-		vec3 wave_0(float x, float y, float t)
+		std::ifstream in(path, std::ios::binary);
+		if (in)
 		{
-			return vec3(0.0, 0.0, 0.0);
+			std::vector<unsigned char> existing((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			if (existing == blob) return Writer_::Writer::SaveResult::Unchanged;
 		}
-		*/
+	}
 
-		class CreateWave_N0
+	std::filesystem::path tmp = path;
+	tmp += ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(blob.data()), std::streamsize(blob.size()));
+		if (!out)
 		{
-		public:
-			bool first = true;
-
-			CreateWave_N0()
-			{
-
-			}
-
-
-			void write(Writer_::Writer& w)
-			{
-				const int index = first ? 0 : 1;
-
-				w.linef("vec3 wave_{}(float x, float y, float t)", index);
-				w.open("{");
-
-				w.blank();
-				w.line("float offset_x = 0.0;");
-				w.line("float offset_y = 0.0;");
-
-				{
-					struct Wave
-					{
-						float amplitude;
-						int frequency;
-						float offset;
-						float time_multiplier;
-
-						float color_r;
-						float color_g;
-						float color_b;
-					};
-
-					std::vector<Wave> waves_x;
-					std::vector<Wave> waves_y;
-
-					{
-						// generate
-
-						for (int i = 0; i < 10; i++)
-						{
-							{
-								float amplitude = Random::generate_random_float_0_to_1();
-								int frequency = Random::random_int(1, 10);
-								float offset = Random::generate_random_float_0_to_1();
-								float time_multiplier = 0.01;
-
-								float color_r = Random::generate_random_float_0_to_1() * 0.2;
-								float color_g = Random::generate_random_float_0_to_1() * 0.2;
-								float color_b = Random::generate_random_float_0_to_1() * 0.2;
-
-								waves_x.push_back({ amplitude, frequency, offset , time_multiplier , color_r, color_g, color_b });
-							}
-
-							{
-								float amplitude = Random::generate_random_float_0_to_1();
-								int frequency = Random::random_int(1, 10);
-								float offset = Random::generate_random_float_0_to_1();
-								float time_multiplier = 0.01;
-
-								float color_r = Random::generate_random_float_0_to_1() * 0.2;
-								float color_g = Random::generate_random_float_0_to_1() * 0.2;
-								float color_b = Random::generate_random_float_0_to_1() * 0.2;
-
-								waves_y.push_back({ amplitude, frequency, offset , time_multiplier , color_r, color_g, color_b });
-							}
-						}
-
-						// normalize
-
-						{
-							// waves_x
-							{
-								int num = waves_x.size();
-
-								float amplitude_sum = 0.0;
-								float color_r_sum = 0.0;
-								float color_g_sum = 0.0;
-								float color_b_sum = 0.0;
-
-								for (int i = 0; i < num; i++)
-								{
-									const Wave& wave = waves_x.at(i);
-									amplitude_sum += wave.amplitude;
-									color_r_sum += wave.color_r;
-									color_g_sum += wave.color_g;
-									color_b_sum += wave.color_b;
-								}
-
-								float factor_amplitude = 1.0;
-
-								if (amplitude_sum > 1.0)
-								{
-									factor_amplitude = 1.0 / amplitude_sum;
-								}
-
-								float factor_color_r = 1.0;
-
-								if (color_r_sum > 1.0)
-								{
-									factor_color_r = 1.0 / color_r_sum;
-								}
-
-								float factor_color_g = 1.0;
-
-								if (color_g_sum > 1.0)
-								{
-									factor_color_g = 1.0 / color_g_sum;
-								}
-
-								float factor_color_b = 1.0;
-
-								if (color_b_sum > 1.0)
-								{
-									factor_color_b = 1.0 / color_b_sum;
-								}
-
-
-								for (Wave& wave : waves_x)
-								{
-									wave.amplitude *= factor_amplitude;
-									wave.color_r *= factor_color_r;
-									wave.color_g *= factor_color_g;
-									wave.color_b *= factor_color_b;
-								}
-
-
-
-
-								
-							}
-							
-						}
-
-					}
-
-
-					for (int i = 0; i < 10; i++)
-					{
-						float amplitude_x = Random::generate_random_float_0_to_1();
-						int frequency_x = Random::random_int(1, 10);
-						float offset_x = Random::generate_random_float_0_to_1();
-
-						float amplitude_y = Random::generate_random_float_0_to_1();
-						int frequency_y = Random::random_int(1, 10);
-						float offset_y = Random::generate_random_float_0_to_1();
-
-						w.linef("offset_x += float({}) * sin(float({}) * x + float({}));", amplitude_x, float(frequency_x), offset_x);
-
-						w.linef("offset_y += float({}) * sin(float({}) * x + float({}));", amplitude_y, float(frequency_y), offset_y);
-
-						// first_wave y 0 
-						// int first_wave_0_y_frequency = int(4);
-						// float first_wave_0_y_offset = float(-4.354416);
-						// float first_wave_0_y_amplitude = float(0.0384163);
-						// float first_wave_0_y_t = uTime * float(-0.0042715347);
-
-						//float offset = 0.0;
-						//offset += amplitude * sin(frequency * x + offset)
-
-					}
-				}
-
-				
-
-				w.blank();
-				w.line("float offset = offset_x + offset_y;");
-
-				// x
-				// amplitude
-				// frequency
-				// offset
+			std::cerr << "Writing " << tmp.string() << " FAILED\n";
+			return Writer_::Writer::SaveResult::Failed;
+		}
+	}
 
-				// y
-				// amplitude
-				// frequency
-				// offset
+	std::error_code ec;
+	std::filesystem::rename(tmp, path, ec);
+	if (ec)
+	{
+		std::cerr << "Rename to " << path.string() << " FAILED (" << ec.message() << ")\n";
+		std::filesystem::remove(tmp, ec);
+		return Writer_::Writer::SaveResult::Failed;
+	}
+	return Writer_::Writer::SaveResult::Written;
+}
 
-				// color_r
-				// color_g
-				// color_b
+inline BatchResult generate_batch(const BatchConfig& config)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(config.output_dir, ec);
+	if (ec)
+	{
+		std::cerr << "Cannot create " << config.output_dir.string() << ": " << ec.message() << "\n";
+	}
 
-				w.line("");
-				w.line("return vec3(0.0, 0.0, 0.0);");
-				w.close("}");
-				w.blank();
-			}
+	std::atomic<size_t> next_index{ 0 };
+	std::atomic<size_t> written{ 0 };
+	std::atomic<size_t> unchanged{ 0 };
+	std::atomic<size_t> failed{ 0 };
 
-		
-		};
+	std::mutex report_mutex;
+	Expr::Report expressions;
 
-		CreateWave_N0 wave;
-		wave.first = true;
-		wave.write(w);
+	auto count = [&](Writer_::Writer::SaveResult result)
+	{
+		switch (result)
+		{
+		case Writer_::Writer::SaveResult::Written:   written++; break;
+		case Writer_::Writer::SaveResult::Unchanged: unchanged++; break;
+		case Writer_::Writer::SaveResult::Failed:    failed++; break;
+		}
+	};
 
+	// A packed WaveBlock is cheaper to produce than to look up, so only baked shaders are cached
+	std::optional<ShaderDiskCache> cache;
+	if (!config.cache_dir.empty() && !config.params.uniform_waves)
+	{
+		cache.emplace(config.cache_dir, config.cache_bytes);
 	}
 
-	w.line("void main()");
-	w.open("{");
-
-	w.line("int id = gl_InstanceID;");
-	w.blank();
-
-	w.line("id =  id + (uGrid.x * uGrid.y * uGrid.z) * int(uDrawcallNumber);");
-	w.blank();
-
-	w.lines(R"GLSL(
-// Per-instance randomness
-    uint s0 = uSeed + uint(id + 0);
-    uint s1 = uSeed + uint(id + 42);
-    uint s2 = uSeed + uint(id + 142);
-    float rnd_x = rand01(s0);
-    float rnd_y = rand01(s1);
-    float rnd_z = rand01(s2);
-
-    // The instancd cube rotation randomization
-    uint s0_rot_x = uSeed + uint(id + 2431);
-    uint s1_rot_y = uSeed + uint(id + 4412);
-    uint s2_rot_y = uSeed + uint(id + 1234);
-    uint s3_rot_angle = uSeed + uint(id + 2332);
-    float rnd_cube_rotation_x = rand01(s0_rot_x);
-    float rnd_cube_rotation_y = rand01(s1_rot_y);
-    float rnd_cube_rotation_z = rand01(s2_rot_y);
-    float rnd_cube_rotation_angle = rand01(s3_rot_angle);
-)GLSL", {});
-	w.blank();
-
+	if (config.params.uniform_waves)
 	{
-		class Wave
+		Writer_::Writer w;
+		write_vertex_shader(w, nullptr, config.params);
+		if (w.save_if_changed(batch_uniform_shader_path(config)) == Writer_::Writer::SaveResult::Failed)
 		{
-		public:
-			enum class Direction
-			{
-				X,
-				Y
-			};
+			failed++;
+		}
+	}
 
-			Direction direction = Direction::X;
+	// The pool already keeps every core busy, so each variant builds its two wave blocks inline
+	// instead of starting two threads of its own; the output is the same
+	VertexShaderParams params = config.params;
+	params.parallel_blocks = false;
 
-			int frequency_index = 1;
-			float offset = 0.0f;
-			float amplitude = 1.0f;
-			float time_multiplier = 0.0;
-			int function_to_use = 0;
+	// Indices are handed out one at a time, so a slow variant never holds up a whole share
+	auto work = [&]
+	{
+		Writer_::SectionCache sections;
+		Expr::Report report;
 
-			void write(Writer_::Writer& w, int index, std::string name)
+		for (size_t index = next_index++; index < config.variants; index = next_index++)
+		{
+			const unsigned seed = Random::derive_seed(config.seed, index);
+
+			if (config.params.uniform_waves)
 			{
-				std::string direction_txt = "x";
-				if (direction == Direction::Y)
-				{
-					direction_txt = "y";
-				}
-
-				w.comment("${NAME} ${DIRECTION} ${INDEX} ", { {"NAME", name}, {"DIRECTION", direction_txt}, {"INDEX", std::to_string(index)} });
-				w.linef("int {}_{}_{}_frequency = int({});", name, index, direction_txt, frequency_index);
-				w.linef("float {}_{}_{}_offset = float({});", name, index, direction_txt, offset);
-				w.linef("float {}_{}_{}_amplitude = float({});", name, index, direction_txt, amplitude);
-				w.linef("float {}_{}_{}_t = uTime * float({});", name, index, direction_txt, float(this->time_multiplier));
-				w.blank();
+				Random::set_seed(seed);
+				count(save_blob_if_changed(batch_wave_block_path(config, index), pack_wave_block(generate_wave_variant(config.params), config.params)));
+				continue;
 			}
 
-			static void generate_waves(std::vector<Wave>& waves, int num)
+			auto generate = [&](Writer_::Writer& w)
 			{
-				for (int i = 0; i < num; i++)
-				{
-					Wave wave;
-					wave.frequency_index = Random::random_int(1, 10);
-					wave.offset = Random::generate_random_float_minus_one_to_plus_one() * 10.0f;
-					wave.amplitude = Random::generate_random_float_minus_one_to_plus_one() * 0.37f * (1.0f / float(i + 1));
-					wave.time_multiplier = Random::generate_random_float_minus_one_to_plus_one() * 0.01f * (1.0f / float(i * i + 1));
-					wave.function_to_use = Random::random_int(0, 10);
-
-					if (Random::generate_random_float_0_to_1() > 0.5f)
-					{
-						wave.direction = Wave::Direction::X;
-					}
-					else
-					{
-						wave.direction = Wave::Direction::Y;
-					}
-
-					waves.push_back(wave);
-				}
-			}
+				Random::set_seed(seed);
+				write_vertex_shader(w, &sections, params, &report);
+			};
 
-			static void normalize_amplitude(std::vector<Wave>& waves)
+			Writer_::Writer w;
+			if (cache)
 			{
-				float total_amplitude = 0.0;
-				for (int i = 0; i < waves.size(); i++)
-				{
-					total_amplitude += waves[i].amplitude;
-				}
-
-				float factor = 1.0 / total_amplitude;
-
-				if (std::abs(total_amplitude) > 1.0)
-				{
-					for (int i = 0; i < waves.size(); i++)
-					{
-						waves[i].amplitude = factor * waves[i].amplitude;
-					}
-				}
+				cache->get_or_generate(shader_cache_key(seed, config.params), w, generate);
 			}
-
-
-			static void write(Writer_::Writer& w, std::vector<Wave>& waves, std::string name)
+			else
 			{
-				{
-					for (int i = 0; i < waves.size(); i++)
-					{
-						waves[i].write(w, i, name);
-					}
-
-				}
-
-				{
-					w.blank();
-					w.line("float ${NAME} = 0.0f;", { {"NAME", name} });
+				generate(w);
+			}
 
+			count(w.save_if_changed(batch_variant_path(config, index)));
+		}
 
+		std::lock_guard lock(report_mutex);
+		expressions += report;
+	};
 
-					for (int i = 0; i < waves.size(); i++)
-					{
-						int function_to_use = waves[i].function_to_use;
+	const size_t thread_count = std::clamp<size_t>(config.threads, 1, std::max<size_t>(config.variants, 1));
 
+	const auto start = std::chrono::steady_clock::now();
 
+	std::vector<std::thread> pool;
+	pool.reserve(thread_count);
+	for (size_t t = 0; t < thread_count; t++)
+	{
+		pool.emplace_back(work);
+	}
+	for (std::thread& thread : pool)
+	{
+		thread.join();
+	}
 
-						w.line
-						(
-							"${NAME} += ${NAME}_${INDEX}_${DIRECTION}_amplitude * f_periodic_${PERIODIC_FUNCTION}(f_adjust_to_two_pi(${NAME}_${INDEX}_${DIRECTION}_offset + ${X_OR_Y} * TAU * ${NAME}_${INDEX}_${DIRECTION}_frequency + ${NAME}_${INDEX}_${DIRECTION}_t * uTime));",
-							{
-								{"NAME", name},
-								{"INDEX", std::to_string(i)},
-								{"DIRECTION", ((waves[i].direction == Wave::Direction::X) ? "x" : "y")},
-								{"PERIODIC_FUNCTION", std::to_string(function_to_use)},
-								{"X_OR_Y", ((waves[i].direction == Wave::Direction::X) ? "rnd_x" : "rnd_y")  }
-							}
-						);
-					}
+	BatchResult result;
+	result.elapsed = std::chrono::steady_clock::now() - start;
+	result.written = written;
+	result.unchanged = unchanged;
+	result.failed = failed;
+	result.expressions = expressions;
+	if (cache)
+	{
+		cache->save_index();
+		result.cache = cache->stats();
+	}
+	return result;
+}
 
+inline bool parse_args(int argc, char** argv, PipelineConfig& config, BatchConfig& batch)
+{
+	int i = 1;
 
-					w.blank();
-					w.linef("{} *= float({});", name, 0.2f);
+	// A plain decimal in [min, max]. std::stoul alone takes "-1" and wraps it to a huge
+	// count, so a sign, trailing text or a value out of range are all rejected here.
+	auto number = [&](unsigned long long min, unsigned long long max)
+	{
+		const std::string text = argv[++i];
+		size_t used = 0;
+		const unsigned long long value = std::stoull(text, &used);
+		if (!std::isdigit(static_cast<unsigned char>(text[0])) || used != text.size() || value < min || value > max)
+		{
+			throw std::out_of_range(text);
+		}
+		return value;
+	};
 
-				}
+	try
+	{
+		for (; i < argc; i++)
+		{
+			std::string a = argv[i];
+			if (a == "--cadence-ms" && i + 1 < argc)  config.cadence = std::chrono::milliseconds(number(0, 24ull * 3600 * 1000));
+			else if (a == "--depth" && i + 1 < argc)  config.queue_depth = number(0, 1024);
+			else if (a == "--runs" && i + 1 < argc)   config.runs = number(0, SIZE_MAX);
+			else if (a == "--out" && i + 1 < argc)    config.output = argv[++i];
+			else if (a == "--batch" && i + 1 < argc)  batch.variants = number(0, SIZE_MAX);
+			else if (a == "--seed" && i + 1 < argc)   batch.seed = number(0, UINT64_MAX);
+			else if (a == "--threads" && i + 1 < argc) batch.threads = static_cast<unsigned>(number(1, 1024));
+			else if (a == "--out-dir" && i + 1 < argc) batch.output_dir = argv[++i];
+			else if (a == "--waves" && i + 1 < argc)  batch.params.wave_count = static_cast<int>(number(1, 4096));
+			else if (a == "--uniform-waves")          batch.params.uniform_waves = true;
+			else if (a == "--optimize-expressions")   batch.params.optimize_expressions = true;
+			else if (a == "--cache-dir" && i + 1 < argc) batch.cache_dir = argv[++i];
+			else if (a == "--cache-mb" && i + 1 < argc) batch.cache_bytes = number(1, UINT64_MAX >> 20) << 20;
+			else
+			{
+				std::cerr << "Unknown/invalid option: " << a << "\n";
+				return false;
 			}
-		};
-
+		}
+	}
+	catch (const std::exception&)
+	{
+		std::cerr << "Invalid value for " << argv[i - 1] << ": " << argv[i] << "\n"
+			<< "Usage: [--cadence-ms N] [--depth N] [--runs N] [--out shader.glsl]\n"
+			<< "       --batch N [--seed S] [--threads N] [--out-dir dir] [--waves N] [--uniform-waves] [--optimize-expressions] [--cache-dir dir] [--cache-mb N]\n"
+			<< "       --threads, --waves and --cache-mb take at least 1\n";
+		return false;
+	}
+	return true;
+}
 
+static double to_ms(std::chrono::steady_clock::duration d)
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
 
-		std::string name_0 = "first_wave";
-		std::string name_1 = "second_wave";
+int main(int argc, char** argv)
+{
+	std::cout << "LetGenerateShadersNicely\n";
 
+	PipelineConfig config;
+	BatchConfig batch;
+	if (!parse_args(argc, argv, config, batch)) return 2;
 
-		{
-			std::vector<Wave> waves;
+	if (batch.variants > 0)
+	{
+		std::cout << "  " << batch.variants << " variants, seed " << batch.seed << ", " << batch.threads << " threads -> " << batch.output_dir.string() << "\n";
 
-			Wave::generate_waves(waves, 20);
-			Wave::normalize_amplitude(waves);
+		BatchResult result = generate_batch(batch);
 
-			Wave::write(w, waves, name_0);
+		const double seconds = std::chrono::duration<double>(result.elapsed).count();
+		std::cout << "  " << result.written << " written, " << result.unchanged << " unchanged, " << result.failed << " failed in "
+			<< seconds << " s (" << (seconds > 0.0 ? double(batch.variants) / seconds : 0.0) << " variants/s)\n";
 
-			w.blank();
+		if (batch.params.optimize_expressions && !batch.params.uniform_waves)
+		{
+			std::cout << "  wave sums before: " << result.expressions.before.to_string() << "\n"
+				<< "             after:  " << result.expressions.after.to_string() << "\n";
 		}
 
-
+		if (batch.params.uniform_waves)
 		{
-			std::vector<Wave> waves;
-
-			Wave::generate_waves(waves, 20);
-			Wave::normalize_amplitude(waves);
-
-			Wave::write(w, waves, name_1);
-
-			w.blank();
-
+			std::cout << "  one shader for all variants: " << batch_uniform_shader_path(batch).string() << ", wave blocks of "
+				<< WaveBlockLayout::size(batch.params.wave_count) << " bytes (std140)\n";
 		}
-
-
+		else if (!batch.cache_dir.empty())
 		{
-			w.line("float f_0 = fract(uTime * 0.1);");
-			w.line("float f_1 = 1.0 - f_0;");
-			w.blank();
-			w.line("float w = f_1 * ${NAME_0} + f_0 * ${NAME_1};", { {"NAME_0", name_0} , {"NAME_1", name_1} });
-
-
+			std::cout << "  cache: " << result.cache.hits << " hits, " << result.cache.misses << " misses ("
+				<< result.cache.hit_rate() * 100.0 << "%), " << result.cache.evictions << " evicted ("
+				<< result.cache.bytes_evicted << " bytes)\n";
 		}
 
+		return result.failed == 0 ? 0 : 1;
 	}
 
+	std::cout << "  cadence " << config.cadence.count() << " ms, " << config.queue_depth << " variant(s) generated ahead\n";
 
-	w.blank();
-
-	w.line("float radius = 0.2 + w;");
-
-	w.lines(R"GLSL(
-// Sphere
-    vec3 sphere_position = spherical01(radius, rnd_x, rnd_y);
-    float px = sphere_position.x;
-    float py = sphere_position.y;
-    float pz = sphere_position.z;
+	ShaderQueue queue(config.queue_depth);
 
-    float color_r = 0.01;
-    float color_g = 0.01;
-    float color_b = 0.01;
-
-    
-    // Instances Cube Scale
-    float scale_cube = 0.001;
-    vec3  pos = vec3(px, pz, py);
-    vec3  scale = vec3(scale_cube, scale_cube, scale_cube);
-
-
-    // Whole object rotation
-
-    vec3 rotation_axis = vec3(0.0, 1.0, 0.0);
-    float rotation_angle = uTime; // using uTime will not be wise after we will be interpolating between two values
-
-    // Whole object scale
-    vec3 scale_object = vec3(1.0, 1.0, 1.0);
-
-    
-
-    vec4 new_position = vec4(vec3(pos), 1.0);
-
-    if (true) {
-
-        uint s0_instance_0 = uSeed + uint(uint(u0 * 1000.0f));
-        uint s0_instance_1 = uSeed + uint(uint(u0 * 1421.0f));
-        float rnd_instance_0 = rand01(s0_instance_0);
-        float rnd_instance_1 = rand01(s0_instance_1);
-
-        uint s0_instance_x_scale = uSeed + uint(uint(u0 * 14024.0f));
-        uint s0_instance_y_scale = uSeed + uint(uint(u0 * 15214.0f));
-        uint s0_instance_z_scale = uSeed + uint(uint(u0 * 14215.0f));
-        float rnd_instance_scale_x = rand01(s0_instance_x_scale);
-        float rnd_instance_scale_y = rand01(s0_instance_y_scale);
-        float rnd_instance_scale_z = rand01(s0_instance_z_scale);
-
-        // Rotation
-        // vec3 axis = normalize(vec3(0.0, 1.0, 1.0));
-        vec3 axis = normalize(rotation_axis);
-        // float angle = uTime;
-        float angle = rotation_angle;
-        mat3 R3 = axisAngleToMat3(axis, angle);
-        mat4 R = mat4(vec4(R3[0], 0.0), vec4(R3[1], 0.0), vec4(R3[2], 0.0), vec4(0, 0, 0, 1));
-
-        // Translation
-        mat4 T = mat4(1.0);
-        vec3 offset = vec3(sin(uTime + rnd_instance_0 * 10.0) * 10.0, sin(uTime + rnd_instance_1 * 0.0) * 10.0, 0.0);
-        offset = vec3(0.5, 0.5, 0.5);
-        T[3] = vec4(offset, 1.0);
-
-
-
-        // Scale
-        mat4 S = mat4(1.0);
-        S[0][0] = scale_object.x;
-        S[1][1] = scale_object.y;
-        S[2][2] = scale_object.z;
-
-        new_position = T * R * S * new_position;
-    }
-
-
-
-    pos = new_position.xyz;
-    
-
-
-
-
-
-    
-    // Per-instance tint (kept neutral here)
-    color_vs = vec3(color_r, color_g, color_b);
-
-    // Build TRS
-    mat4 T = mat4(1.0); T[3] = vec4(pos, 1.0);
-    vec3 axis = normalize(vec3(rnd_cube_rotation_x, rnd_cube_rotation_y, rnd_cube_rotation_z));
-    float angle = rnd_cube_rotation_angle;//uTime * 0.0;
-    mat3 R3 = axisAngleToMat3(axis, angle);
-    mat4 R = mat4(vec4(R3[0], 0.0), vec4(R3[1], 0.0), vec4(R3[2], 0.0), vec4(0, 0, 0, 1));
-    mat4 S = mat4(1.0); S[0][0] = scale.x; S[1][1] = scale.y; S[2][2] = scale.z;
-
-    mat4 instanceModel = T * R * S;
-    mat4 M = model * instanceModel;
-
-    // World-space position (for lighting)
-    vec4 wp = M * vec4(aPos, 1.0);
-    vWorldPos = wp.xyz;
-
-    // World-space normal:
-    // Fast path (assumes uniform scale): rotate the face normal by model rotation and R3.
-    // If you later use non-uniform model scale, switch to normal matrix:
-    //   mat3 N = transpose(inverse(mat3(M)));
-    //   vNormal = normalize(N * nLocal);
-    vec3 nLocal = localCubeFaceNormal(aPos);
-    vNormal = normalize(mat3(model) * (R3 * nLocal)); // uniform-scale assumption
-
-    // Clip-space position and UV
-    gl_Position = projection * view * wp;
-    TexCoord = aTexCoord;
-
-
-    // World position color
+	std::thread worker([&] {
+		Writer_::SectionCache sections;
+		for (size_t index = 0; queue.push(generate_shader(sections, index)); index++)
+		{
+		}
+	});
 
-    // float world_x = wp.x;
-    // float world_y = wp.y;
-    // float world_z = wp.z;
-    // color_vs = vec3(sin(world_x * 10.0), sin(world_y * 10.0), sin(world_z * 10.0)) * vec3(0.01, 0.01, 0.01);
-)GLSL", {});
+	auto next = std::chrono::steady_clock::now();
 
-	w.close("}");
+	for (size_t published = 0; config.runs == 0 || published < config.runs; published++)
+	{
+		const auto wait_start = std::chrono::steady_clock::now();
 
+		GeneratedShader shader;
+		if (!queue.pop(shader)) break;
 
-	w.save("C:/Users/Cosmos/Documents/GitHub/Tmp/Tmp/shaders/vertex_9.glsl");
+		const auto waited = std::chrono::steady_clock::now() - wait_start;
+		const size_t ready = queue.size();
 
-	
-}
+		Writer_::Writer::SaveResult result = publish_shader(shader, config.output);
 
-int main()
-{
-	std::cout << "LetGenerateShadersNicely\n";
-
-	auto next = std::chrono::steady_clock::now();
-
-	while (true)
-	{
-		next += 4s;
+		if (result == Writer_::Writer::SaveResult::Written)
+		{
+			std::cout << "Shader " << shader.index << " generated\n";
+		}
+		else if (result == Writer_::Writer::SaveResult::Unchanged)
+		{
+			std::cout << "Shader " << shader.index << " generated (unchanged, not written)\n";
+		}
+		else
+		{
+			std::cout << "Shader " << shader.index << " generation FAILED to save\n";
+		}
 
-		generate_shader();
+		std::cout << "  generation " << to_ms(shader.latency) << " ms, waited " << to_ms(waited) << " ms for it, "
+			<< ready << " ready in the queue, " << shader.sections_reused << " sections reused\n";
 
+		// A tick missed while waiting is not made up for with a burst of publishes
+		next = std::max(next + config.cadence, std::chrono::steady_clock::now());
 		std::this_thread::sleep_until(next);
-		std::cout << "Shader generated\n";
 	}
 
-	generate_shader();
-
+	queue.stop();
+	worker.join();
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+
+
+
+// Pass/fail tally shared by the self-check headers (WriterChecks.h, Std140PackingCheck.h):
+// each check calls expect, main prints the count and returns non-zero on any failure.
+namespace SelfCheck
+{
+	struct Report
+	{
+		size_t checks = 0;
+		size_t failures = 0;
+
+		void expect(bool ok, const std::string& what)
+		{
+			checks++;
+			if (!ok)
+			{
+				failures++;
+				std::cout << "  FAIL: " << what << "\n";
+			}
+		}
+	};
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include "Writer.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+
+
+
+
+// Persistent, content-addressed store of generated shaders. An entry is keyed by a hash of
+// everything that decides the output (generator version, seed, parameters); its GLSL lives
+// in <dir>/<key>.glsl. <dir>/index.txt lists key and size, least recently used first, and is
+// read back on construction. When the total size goes over the budget the least recently
+// used entries are deleted. All members are safe to call from several threads; the lock only
+// covers the index and LRU bookkeeping, file reads and writes happen outside of it.
+class ShaderDiskCache
+{
+public:
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t stores = 0;
+		size_t evictions = 0;
+		uint64_t bytes_evicted = 0;
+
+		double hit_rate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+	};
+
+	ShaderDiskCache(std::filesystem::path dir, uint64_t max_bytes) : dir_(std::move(dir)), max_bytes_(max_bytes)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(dir_, ec);
+		load_index();
+	}
+
+	~ShaderDiskCache() { save_index(); }
+
+	ShaderDiskCache(const ShaderDiskCache&) = delete;
+	ShaderDiskCache& operator=(const ShaderDiskCache&) = delete;
+
+	// On a hit appends the cached shader to out, line by line, and marks it most recently used
+	bool find(uint64_t key, Writer_::Writer& out)
+	{
+		uint64_t bytes = 0;
+		{
+			std::lock_guard lock(mutex_);
+			auto it = index_.find(key);
+			if (it == index_.end())
+			{
+				stats_.misses++;
+				return false;
+			}
+			bytes = it->second->bytes;
+		}
+
+		// Entries are replaced by rename, so this sees a whole file or none
+		std::ifstream in(entry_path(key), std::ios::binary);
+		std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		const bool intact = in.is_open() && text.size() == bytes;
+
+		{
+			std::lock_guard lock(mutex_);
+			auto it = index_.find(key);
+			if (!intact)
+			{
+				// Deleted or edited behind our back: forget it and let the caller regenerate.
+				// An entry evicted or stored again meanwhile is someone else's business.
+				if (it != index_.end() && it->second->bytes == bytes)
+				{
+					std::cerr << "[ShaderDiskCache] dropping damaged entry " << key_name(key) << "\n";
+					total_bytes_ -= bytes;
+					lru_.erase(it->second);
+					index_.erase(it);
+					dirty_ = true;
+				}
+				stats_.misses++;
+				return false;
+			}
+
+			if (it != index_.end())
+			{
+				lru_.splice(lru_.end(), lru_, it->second);
+				dirty_ = true;
+			}
+			stats_.hits++;
+		}
+
+		for (size_t begin = 0; begin < text.size(); )
+		{
+			size_t end = text.find('\n', begin);
+			if (end == std::string::npos) end = text.size();
+			out.append_raw(std::string_view(text).substr(begin, end - begin));
+			begin = end + 1;
+		}
+		return true;
+	}
+
+	bool store(uint64_t key, const Writer_::Writer& shader)
+	{
+		// Written to a temp file renamed over the entry, so concurrent finds never see it half done
+		if (shader.save_if_changed(entry_path(key)) == Writer_::Writer::SaveResult::Failed)
+		{
+			return false;
+		}
+
+		const uint64_t bytes = shader.byte_size();
+		std::vector<uint64_t> evicted;
+		{
+			std::lock_guard lock(mutex_);
+
+			auto it = index_.find(key);
+			if (it != index_.end())
+			{
+				total_bytes_ -= it->second->bytes;
+				lru_.erase(it->second);
+			}
+			lru_.push_back({ key, bytes });
+			index_[key] = std::prev(lru_.end());
+			total_bytes_ += bytes;
+			dirty_ = true;
+			stats_.stores++;
+
+			evicted = evict();
+		}
+
+		remove_entries(evicted);
+		return true;
+	}
+
+	// Cached text for key, or generate(Writer&) run into out and stored under key
+	template<class Fn>
+	void get_or_generate(uint64_t key, Writer_::Writer& out, Fn&& generate)
+	{
+		if (find(key, out)) return;
+		generate(out);
+		store(key, out);
+	}
+
+	// Written through a temp file + rename, so a crash never leaves a truncated index
+	bool save_index()
+	{
+		// The text is taken under the lock; writes are serialized among themselves only, so
+		// two saves never interleave in the temp file and the newer snapshot lands last
+		std::lock_guard save_lock(save_mutex_);
+		std::ostringstream text;
+		{
+			std::lock_guard lock(mutex_);
+			if (!dirty_) return true;
+
+			text << kIndexHeader << "\n";
+			for (const Entry& entry : lru_)
+			{
+				text << key_name(entry.key) << " " << entry.bytes << "\n";
+			}
+			dirty_ = false;
+		}
+
+		const std::filesystem::path path = dir_ / "index.txt";
+		std::filesystem::path tmp = path;
+		tmp += ".tmp";
+		bool written = false;
+		{
+			std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+			out << text.str();
+			written = static_cast<bool>(out);
+		}
+
+		std::error_code ec;
+		if (written) std::filesystem::rename(tmp, path, ec);
+		if (!written || ec)
+		{
+			if (!written) std::cerr << "[ShaderDiskCache] writing " << tmp.string() << " FAILED\n";
+			else std::cerr << "[ShaderDiskCache] rename to " << path.string() << " FAILED (" << ec.message() << ")\n";
+			std::lock_guard lock(mutex_);
+			dirty_ = true;
+			return false;
+		}
+		return true;
+	}
+
+	Stats stats() { std::lock_guard lock(mutex_); return stats_; }
+	void reset_stats() { std::lock_guard lock(mutex_); stats_ = {}; }
+	size_t size() { std::lock_guard lock(mutex_); return lru_.size(); }
+	uint64_t total_bytes() { std::lock_guard lock(mutex_); return total_bytes_; }
+
+private:
+	static constexpr const char* kIndexHeader = "shader-cache 1";
+
+	struct Entry
+	{
+		uint64_t key;
+		uint64_t bytes;
+	};
+
+	static std::string key_name(uint64_t key)
+	{
+		char name[17];
+		std::snprintf(name, sizeof name, "%016llx", static_cast<unsigned long long>(key));
+		return name;
+	}
+
+	std::filesystem::path entry_path(uint64_t key) const { return dir_ / (key_name(key) + ".glsl"); }
+
+	// Entries whose file is gone or has another size are skipped; an unknown header starts empty
+	void load_index()
+	{
+		std::ifstream in(dir_ / "index.txt");
+		std::string line;
+		if (!in || !std::getline(in, line) || line != kIndexHeader) return;
+
+		while (std::getline(in, line))
+		{
+			std::istringstream fields(line);
+			std::string name;
+			uint64_t bytes = 0;
+			if (!(fields >> name >> bytes)) continue;
+
+			const uint64_t key = std::strtoull(name.c_str(), nullptr, 16);
+			std::error_code ec;
+			if (index_.count(key) || std::filesystem::file_size(entry_path(key), ec) != bytes || ec)
+			{
+				dirty_ = true;
+				continue;
+			}
+
+			lru_.push_back({ key, bytes });
+			index_[key] = std::prev(lru_.end());
+			total_bytes_ += bytes;
+		}
+
+		remove_entries(evict());
+	}
+
+	// Drops least recently used entries from the index until the budget holds; the caller
+	// deletes their files once it has let go of the lock
+	std::vector<uint64_t> evict()
+	{
+		std::vector<uint64_t> victims;
+		while (total_bytes_ > max_bytes_ && !lru_.empty())
+		{
+			const Entry victim = lru_.front();
+			victims.push_back(victim.key);
+
+			index_.erase(victim.key);
+			lru_.pop_front();
+			total_bytes_ -= victim.bytes;
+			stats_.evictions++;
+			stats_.bytes_evicted += victim.bytes;
+			dirty_ = true;
+		}
+		return victims;
+	}
+
+	void remove_entries(const std::vector<uint64_t>& keys) const
+	{
+		for (uint64_t key : keys)
+		{
+			std::error_code ec;
+			std::filesystem::remove(entry_path(key), ec);
+		}
+	}
+
+	std::filesystem::path dir_;
+	uint64_t max_bytes_;
+	uint64_t total_bytes_ = 0;
+	std::list<Entry> lru_;   // least recently used first
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+	Stats stats_;
+	bool dirty_ = false;
+	std::mutex mutex_;        // index_, lru_, total_bytes_, stats_, dirty_
+	std::mutex save_mutex_;   // the index file
+};
@@ -0,0 +1,376 @@
+#pragma once
+
+#include "Writer.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <format>
+#include <cstring>
+
+
+
+
+// A small expression IR for generated GLSL. Generator code builds float expressions out of
+// constants, variables, sums, products and calls; the passes then fold constants, simplify,
+// and hoist repeated subexpressions into temporaries before the result goes out through a
+// Writer. Nodes are hash-consed, so structurally equal subtrees are one node.
+namespace Expr
+{
+	enum class Op { Const, Var, Add, Mul, Call };
+
+	struct Node
+	{
+		Op op = Op::Const;
+		double value = 0.0;       // Const
+		std::string name;         // Var, Call; a Const with a name prints as that name until folded
+		std::vector<int> args;    // Add, Mul, Call
+	};
+
+	// Arithmetic as the emitted text performs it: an n-term sum is n - 1 adds
+	struct OpCounts
+	{
+		size_t adds = 0;
+		size_t muls = 0;
+		size_t calls = 0;
+		size_t temporaries = 0;
+
+		size_t total() const { return adds + muls + calls; }
+
+		OpCounts& operator+=(const OpCounts& o)
+		{
+			adds += o.adds;
+			muls += o.muls;
+			calls += o.calls;
+			temporaries += o.temporaries;
+			return *this;
+		}
+
+		std::string to_string() const
+		{
+			return std::format("{} ops ({} adds, {} muls, {} calls, {} temporaries)", total(), adds, muls, calls, temporaries);
+		}
+	};
+
+	struct Report
+	{
+		OpCounts before;
+		OpCounts after;
+
+		Report& operator+=(const Report& o)
+		{
+			before += o.before;
+			after += o.after;
+			return *this;
+		}
+	};
+
+	class Program
+	{
+	public:
+		using Inline = std::function<int(Program&, const std::vector<int>&)>;
+
+		int constant(double value) { return make({ Op::Const, value, {}, {} }); }
+		int constant(std::string_view name, double value) { return make({ Op::Const, value, std::string(name), {} }); }
+		int var(std::string_view name) { return make({ Op::Var, 0.0, std::string(name), {} }); }
+		// An empty sum is 0 and an empty product 1, so every Add and Mul node has operands
+		int add(std::vector<int> terms) { return terms.empty() ? constant(0.0) : make({ Op::Add, 0.0, {}, std::move(terms) }); }
+		int mul(std::vector<int> factors) { return factors.empty() ? constant(1.0) : make({ Op::Mul, 0.0, {}, std::move(factors) }); }
+		int call(std::string_view fn, std::vector<int> args) { return make({ Op::Call, 0.0, std::string(fn), std::move(args) }); }
+
+		// simplify() replaces calls of fn by what expand builds from the call's arguments
+		void define_inline(std::string_view fn, Inline expand) { inline_[std::string(fn)] = std::move(expand); }
+
+		// Emitted as "float name = root;"
+		void output(std::string name, int root) { outputs_.push_back({ std::move(name), root }); }
+
+		// Flattens nested sums and products, folds their constants, drops +0 / *1, turns *0 into
+		// 0, expands inline functions and pushes a constant factor into a sum whose terms all
+		// carry a constant (c * (k0 + k1 * x) -> c*k0 + c*k1 * x costs no extra multiply).
+		// Operands end up in a canonical order, so x * y and y * x become the same node.
+		void simplify()
+		{
+			std::unordered_map<int, int> memo;
+			for (auto& [name, root] : outputs_)
+			{
+				root = simplify(root, memo);
+			}
+		}
+
+		// Every Add/Mul/Call node reached from more than one place is computed once, into a
+		// temporary named <prefix>_<n>
+		void eliminate_common_subexpressions(std::string_view prefix)
+		{
+			std::vector<int> uses(nodes_.size(), 0);
+			std::vector<bool> seen(nodes_.size(), false);
+			std::function<void(int)> visit = [&](int id)
+			{
+				uses[id]++;
+				if (seen[id]) return;
+				seen[id] = true;
+				for (int arg : nodes_[id].args) visit(arg);
+			};
+			for (const auto& [name, root] : outputs_) visit(root);
+
+			for (int id = 0; id < int(nodes_.size()); id++)   // children always have lower ids
+			{
+				const Op op = nodes_[id].op;
+				if (uses[id] > 1 && (op == Op::Add || op == Op::Mul || op == Op::Call) && !temp_names_.count(id))
+				{
+					temp_names_[id] = std::format("{}_{}", prefix, temp_order_.size());
+					temp_order_.push_back(id);
+				}
+			}
+		}
+
+		OpCounts count() const
+		{
+			OpCounts counts;
+			for (int id : temp_order_) count(id, true, counts);
+			for (const auto& [name, root] : outputs_) count(root, false, counts);
+			counts.temporaries = temp_order_.size();
+			return counts;
+		}
+
+		// Temporaries first, then the outputs; an output that is a sum goes out one term a line
+		void emit(Writer_::Writer& w) const
+		{
+			for (int id : temp_order_)
+			{
+				w.linef("float {} = {};", temp_names_.at(id), text(id, true));
+			}
+
+			for (const auto& [name, root] : outputs_)
+			{
+				const Node& node = nodes_[root];
+				if (node.op != Op::Add || temp_names_.count(root))
+				{
+					w.linef("float {} = {};", name, text(root, false));
+					continue;
+				}
+
+				w.linef("float {} = {};", name, text(node.args[0], false));
+				for (size_t i = 1; i < node.args.size(); i++)
+				{
+					const int term = node.args[i];
+					if (leading_constant(term) < 0.0)
+					{
+						w.linef("{} -= {};", name, text(term, false, true));
+					}
+					else
+					{
+						w.linef("{} += {};", name, text(term, false));
+					}
+				}
+			}
+		}
+
+	private:
+		int make(Node node)
+		{
+			std::string key;
+			key.reserve(32);
+			key += char('0' + int(node.op));
+			if (node.op == Op::Const)
+			{
+				char bits[sizeof node.value];
+				std::memcpy(bits, &node.value, sizeof bits);
+				key.append(bits, sizeof bits);
+			}
+			key += node.name;
+			for (int arg : node.args)
+			{
+				key += ',';
+				key += std::to_string(arg);
+			}
+
+			auto [it, inserted] = index_.try_emplace(std::move(key), int(nodes_.size()));
+			if (inserted) nodes_.push_back(std::move(node));
+			return it->second;
+		}
+
+		bool is_const(int id) const { return nodes_[id].op == Op::Const; }
+
+		// The coefficient of a product in canonical form (a Const first), or of a constant
+		double leading_constant(int id) const
+		{
+			const Node& node = nodes_[id];
+			if (node.op == Op::Const) return node.value;
+			if (node.op == Op::Mul && !temp_names_.count(id) && is_const(node.args[0])) return nodes_[node.args[0]].value;
+			return 1.0;
+		}
+
+		bool carries_constant(int id) const
+		{
+			const Node& node = nodes_[id];
+			return node.op == Op::Const || (node.op == Op::Mul && is_const(node.args[0]));
+		}
+
+		int simplify(int id, std::unordered_map<int, int>& memo)
+		{
+			if (auto it = memo.find(id); it != memo.end()) return it->second;
+
+			const Node node = nodes_[id];
+			int result = id;
+
+			if (node.op == Op::Const && !node.name.empty())
+			{
+				result = constant(node.value);
+			}
+			else if (node.op == Op::Call)
+			{
+				std::vector<int> args;
+				for (int arg : node.args) args.push_back(simplify(arg, memo));
+
+				auto expand = inline_.find(node.name);
+				result = expand != inline_.end() ? simplify(expand->second(*this, args), memo) : call(node.name, std::move(args));
+			}
+			else if (node.op == Op::Add)
+			{
+				double sum = 0.0;
+				std::vector<int> terms;
+				std::function<void(int)> collect = [&](int term)
+				{
+					const Node& t = nodes_[term];
+					if (t.op == Op::Const) sum += t.value;
+					else if (t.op == Op::Add) for (int inner : t.args) collect(inner);
+					else terms.push_back(term);
+				};
+				for (int arg : node.args) collect(simplify(arg, memo));
+
+				std::sort(terms.begin(), terms.end());
+				if (sum != 0.0) terms.insert(terms.begin(), constant(sum));
+
+				result = terms.empty() ? constant(0.0) : terms.size() == 1 ? terms[0] : add(std::move(terms));
+			}
+			else if (node.op == Op::Mul)
+			{
+				double product = 1.0;
+				std::vector<int> factors;
+				std::function<void(int)> collect = [&](int factor)
+				{
+					const Node& f = nodes_[factor];
+					if (f.op == Op::Const) product *= f.value;
+					else if (f.op == Op::Mul) for (int inner : f.args) collect(inner);
+					else factors.push_back(factor);
+				};
+				for (int arg : node.args) collect(simplify(arg, memo));
+
+				std::sort(factors.begin(), factors.end());
+
+				if (product == 0.0 || factors.empty())
+				{
+					result = constant(product);
+				}
+				else if (product != 1.0 && factors.size() == 1 && nodes_[factors[0]].op == Op::Add
+					&& std::all_of(nodes_[factors[0]].args.begin(), nodes_[factors[0]].args.end(), [&](int t) { return carries_constant(t); }))
+				{
+					const std::vector<int> sum = nodes_[factors[0]].args;
+					std::vector<int> terms;
+					for (int term : sum) terms.push_back(mul({ constant(product), term }));
+					result = simplify(add(std::move(terms)), memo);
+				}
+				else
+				{
+					// The variable part is a node of its own, so c0 * x * y and c1 * x * y share x * y
+					const int rest = factors.size() == 1 ? factors[0] : mul(factors);
+					result = product == 1.0 ? rest : mul({ constant(product), rest });
+				}
+			}
+
+			memo[id] = result;
+			return result;
+		}
+
+		void count(int id, bool root, OpCounts& counts) const
+		{
+			if (!root && temp_names_.count(id)) return;
+
+			const Node& node = nodes_[id];
+			const size_t n = node.args.size();
+			if (node.op == Op::Add && n > 1) counts.adds += n - 1;
+			if (node.op == Op::Mul && n > 1) counts.muls += n - 1;
+			if (node.op == Op::Call) counts.calls++;
+			for (int arg : node.args) count(arg, false, counts);
+		}
+
+		static std::string literal(double value)
+		{
+			if (value == 0.0) return "0.0";
+
+			// Shortest text that reads back as the same float, made a GLSL float literal
+			std::string text = std::format("{}", float(value));
+			if (text.find_first_of(".e") == std::string::npos) text += ".0";
+			return text;
+		}
+
+		// negate is only for terms with a negative leading constant: a + -2 * b prints as a - 2 * b
+		std::string text(int id, bool root, bool negate = false) const
+		{
+			if (!root)
+			{
+				if (auto it = temp_names_.find(id); it != temp_names_.end()) return it->second;
+			}
+
+			const Node& node = nodes_[id];
+			switch (node.op)
+			{
+			case Op::Const:
+				return negate ? literal(-node.value) : node.name.empty() ? literal(node.value) : node.name;
+
+			case Op::Var:
+				return node.name;
+
+			case Op::Call:
+			{
+				std::string s = node.name + "(";
+				for (size_t i = 0; i < node.args.size(); i++)
+				{
+					if (i) s += ", ";
+					s += text(node.args[i], false);
+				}
+				return s + ")";
+			}
+
+			case Op::Add:
+			{
+				std::string s = text(node.args[0], false);
+				for (size_t i = 1; i < node.args.size(); i++)
+				{
+					const int term = node.args[i];
+					if (leading_constant(term) < 0.0) s += " - " + text(term, false, true);
+					else s += " + " + text(term, false);
+				}
+				return s;
+			}
+
+			case Op::Mul:
+			{
+				std::string s;
+				for (size_t i = 0; i < node.args.size(); i++)
+				{
+					const int factor = node.args[i];
+					if (i == 0 && negate && -nodes_[factor].value == 1.0) continue;
+
+					const bool sum = nodes_[factor].op == Op::Add && !temp_names_.count(factor);
+					if (!s.empty()) s += " * ";
+					s += sum ? "(" + text(factor, false) + ")" : text(factor, false, i == 0 && negate);
+				}
+				return s;
+			}
+			}
+			return {};
+		}
+
+		std::vector<Node> nodes_;
+		std::unordered_map<std::string, int> index_;   // structural key -> node
+		std::map<std::string, Inline> inline_;
+		std::vector<std::pair<std::string, int>> outputs_;
+		std::vector<int> temp_order_;                  // temporaries in dependency order
+		std::unordered_map<int, std::string> temp_names_;   // node -> its temporary
+	};
+}
@@ -0,0 +1,997 @@
+#pragma once
+
+#include "CppCommponents/Random.h"
+
+#include "Writer.h"
+#include "ShaderExpr.h"
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+
+
+// What write_vertex_shader emits besides the engine state. Together with the seed it keys the
+// on-disk shader cache, so bump version whenever the generator's output changes.
+struct VertexShaderParams
+{
+	static constexpr uint32_t version = 1;
+	int wave_count = 20;   // per wave block
+	bool uniform_waves = false;   // read the waves from the WaveBlock uniform buffer instead of baking them in
+	bool optimize_expressions = false;   // baked sums go through Expr's passes (folded constants round differently)
+	bool parallel_blocks = true;   // the two baked wave blocks on threads of their own; same output either way
+};
+
+class Wave
+{
+public:
+	enum class Direction
+	{
+		X,
+		Y
+	};
+
+	Direction direction = Direction::X;
+
+	int frequency_index = 1;
+	float offset = 0.0f;
+	float amplitude = 1.0f;
+	float time_multiplier = 0.0;
+	int function_to_use = 0;
+
+	void write(Writer_::Writer& w, int index, std::string name)
+	{
+		std::string direction_txt = "x";
+		if (direction == Direction::Y)
+		{
+			direction_txt = "y";
+		}
+
+		w.comment(Writer_::Template<"${NAME} ${DIRECTION} ${INDEX} ">{}, Writer_::arg<"NAME">(name), Writer_::arg<"DIRECTION">(direction_txt), Writer_::arg<"INDEX">(index));
+		w.linef("int {}_{}_{}_frequency = int({});", name, index, direction_txt, frequency_index);
+		w.linef("float {}_{}_{}_offset = float({});", name, index, direction_txt, offset);
+		w.linef("float {}_{}_{}_amplitude = float({});", name, index, direction_txt, amplitude);
+		w.linef("float {}_{}_{}_t = uTime * float({});", name, index, direction_txt, float(this->time_multiplier));
+		w.blank();
+	}
+
+	static void generate_waves(std::vector<Wave>& waves, int num)
+	{
+		for (int i = 0; i < num; i++)
+		{
+			Wave wave;
+			wave.frequency_index = Random::random_int(1, 10);
+			wave.offset = Random::generate_random_float_minus_one_to_plus_one() * 10.0f;
+			wave.amplitude = Random::generate_random_float_minus_one_to_plus_one() * 0.37f * (1.0f / float(i + 1));
+			wave.time_multiplier = Random::generate_random_float_minus_one_to_plus_one() * 0.01f * (1.0f / float(i * i + 1));
+			wave.function_to_use = Random::random_int(0, 10);
+
+			if (Random::generate_random_float_0_to_1() > 0.5f)
+			{
+				wave.direction = Wave::Direction::X;
+			}
+			else
+			{
+				wave.direction = Wave::Direction::Y;
+			}
+
+			waves.push_back(wave);
+		}
+	}
+
+	static void normalize_amplitude(std::vector<Wave>& waves)
+	{
+		float total_amplitude = 0.0;
+		for (int i = 0; i < waves.size(); i++)
+		{
+			total_amplitude += waves[i].amplitude;
+		}
+
+		float factor = 1.0 / total_amplitude;
+
+		if (std::abs(total_amplitude) > 1.0)
+		{
+			for (int i = 0; i < waves.size(); i++)
+			{
+				waves[i].amplitude = factor * waves[i].amplitude;
+			}
+		}
+	}
+
+
+	static void write(Writer_::Writer& w, std::vector<Wave>& waves, std::string name)
+	{
+		{
+			for (int i = 0; i < waves.size(); i++)
+			{
+				waves[i].write(w, i, name);
+			}
+
+		}
+
+		{
+			w.blank();
+
+			// The whole sum is one template instantiation, a row per wave
+			Writer_::Table rows({ "INDEX", "DIRECTION", "PERIODIC_FUNCTION", "X_OR_Y" });
+			rows.reserve(waves.size());
+			for (size_t i = 0; i < waves.size(); i++)
+			{
+				bool is_x = waves[i].direction == Wave::Direction::X;
+				rows.add_row({ i, is_x ? "x" : "y", waves[i].function_to_use, is_x ? "rnd_x" : "rnd_y" });
+			}
+
+			w.lines
+			(
+				"float ${NAME} = 0.0f;\n"
+				"${#each WAVES}\n"
+				"${NAME} += ${NAME}_${INDEX}_${DIRECTION}_amplitude * f_periodic_${PERIODIC_FUNCTION}(f_adjust_to_two_pi(${NAME}_${INDEX}_${DIRECTION}_offset + ${X_OR_Y} * TAU * ${NAME}_${INDEX}_${DIRECTION}_frequency + ${NAME}_${INDEX}_${DIRECTION}_t * uTime));\n"
+				"${/each}\n",
+				{ {"NAME", name}, {"WAVES", rows} }
+			);
+
+			w.blank();
+			w.linef("{} *= float({});", name, 0.2f);
+
+		}
+	}
+
+	// The GLSL const of the same name
+	static constexpr double tau = 6.2831853071795864769252867665590;
+
+	// The sum write() emits, as an expression with the per-wave locals substituted
+	static int build(Expr::Program& p, const std::vector<Wave>& waves)
+	{
+		std::vector<int> terms;
+		for (const Wave& wave : waves)
+		{
+			const int u_time = p.var("uTime");
+			const int rnd = p.var(wave.direction == Direction::X ? "rnd_x" : "rnd_y");
+			const int t = p.mul({ u_time, p.constant(wave.time_multiplier) });
+
+			const int phase = p.add({ p.constant(wave.offset), p.mul({ rnd, p.constant("TAU", tau), p.constant(wave.frequency_index) }), p.mul({ t, u_time }) });
+			const int periodic = p.call("f_periodic_" + std::to_string(wave.function_to_use), { p.call("f_adjust_to_two_pi", { phase }) });
+
+			terms.push_back(p.mul({ p.constant(wave.amplitude), periodic }));
+		}
+
+		return p.mul({ p.add(std::move(terms)), p.constant(0.2f) });
+	}
+
+	// Both wave sums through one Program, so they share their temporaries. The op counts before
+	// and after the passes go into the shader as a comment and, with report, to the caller.
+	static void write_optimized(Writer_::Writer& w, const std::string (&names)[2], const std::vector<Wave> (&waves)[2], Expr::Report* report)
+	{
+		Expr::Program p;
+		p.define_inline("f_adjust_to_two_pi", [](Expr::Program& p, const std::vector<int>& args) { return p.mul({ args[0], p.constant(1.0 / tau) }); });
+		p.output(names[0], build(p, waves[0]));
+		p.output(names[1], build(p, waves[1]));
+
+		Expr::Report counts;
+		counts.before = p.count();
+		p.simplify();
+		p.eliminate_common_subexpressions("wave_common");
+		counts.after = p.count();
+
+		if (report) *report += counts;
+
+		w.comment("wave sums, before: " + counts.before.to_string());
+		w.comment("           after:  " + counts.after.to_string());
+		p.emit(w);
+		w.blank();
+	}
+};
+
+// One wave sum, drawn from its own seed so the two sums can be generated on separate threads
+inline std::vector<Wave> generate_wave_block(unsigned seed, int wave_count)
+{
+	Random::set_seed(seed);
+
+	std::vector<Wave> waves;
+	Wave::generate_waves(waves, wave_count);
+	Wave::normalize_amplitude(waves);
+	return waves;
+}
+
+// Runs the jobs of the two wave blocks, on two threads when parallel. Run inline they re-seed
+// this thread's engine (see generate_wave_block), so its state is put back afterwards and the
+// caller draws what it would have drawn with the threads.
+template<class Block0, class Block1>
+inline void run_wave_blocks(bool parallel, Block0&& block_0, Block1&& block_1)
+{
+	if (parallel)
+	{
+		std::thread worker_0(block_0);
+		std::thread worker_1(block_1);
+		worker_0.join();
+		worker_1.join();
+		return;
+	}
+
+	const std::mt19937 engine = Random::engine();
+	block_0();
+	block_1();
+	Random::engine() = engine;
+}
+
+// The random part of a uniform-buffer variant: the two wave sums main() blends between.
+// Draws the two block seeds from this thread's engine, then re-seeds it per block.
+struct WaveVariant
+{
+	std::vector<Wave> first;
+	std::vector<Wave> second;
+};
+
+inline WaveVariant generate_wave_variant(const VertexShaderParams& params)
+{
+	const unsigned seed_0 = Random::engine()();
+	const unsigned seed_1 = Random::engine()();
+
+	WaveVariant variant;
+	variant.first = generate_wave_block(seed_0, params.wave_count);
+	variant.second = generate_wave_block(seed_1, params.wave_count);
+	return variant;
+}
+
+
+// Byte layout of the WaveBlock uniform block declared by write_wave_block_declaration, under
+// std140: int/float align to 4, an array of structs aligns to 16 and its stride is the struct
+// size rounded up to 16 (24 -> 32 here).
+struct WaveBlockLayout
+{
+	static constexpr const char* names[2] = { "first_wave", "second_wave" };
+
+	static constexpr size_t first_count = 0;
+	static constexpr size_t second_count = 4;
+	static constexpr size_t first_params = 16;
+
+	// inside one WaveParams element
+	static constexpr size_t amplitude = 0;
+	static constexpr size_t offset = 4;
+	static constexpr size_t frequency = 8;
+	static constexpr size_t time_multiplier = 12;
+	static constexpr size_t periodic_function = 16;
+	static constexpr size_t direction = 20;
+	static constexpr size_t params_stride = 32;
+
+	static constexpr size_t second_params(int wave_count) { return first_params + size_t(wave_count) * params_stride; }
+	static constexpr size_t size(int wave_count) { return second_params(wave_count) + size_t(wave_count) * params_stride; }
+};
+
+inline void write_wave_block_declaration(Writer_::Writer& w, const VertexShaderParams& params)
+{
+	w.lines(R"GLSL(
+// wave parameters, std140 (filled by pack_wave_block)
+struct WaveParams
+{
+    float amplitude;
+    float offset;
+    int frequency;
+    float time_multiplier;
+    int periodic_function;
+    int direction;    // 0 = x, 1 = y
+};
+
+layout(std140, binding = 0) uniform WaveBlock
+{
+    int ${NAME_0}_count;
+    int ${NAME_1}_count;
+    WaveParams ${NAME_0}_params[${WAVE_COUNT}];
+    WaveParams ${NAME_1}_params[${WAVE_COUNT}];
+};
+)GLSL", { {"NAME_0", WaveBlockLayout::names[0]}, {"NAME_1", WaveBlockLayout::names[1]}, {"WAVE_COUNT", params.wave_count} });
+	w.blank();
+}
+
+// The WaveBlock contents of one variant. Switching variants is then an upload of these bytes
+// (glBufferSubData) instead of a new shader to compile.
+inline std::vector<unsigned char> pack_wave_block(const WaveVariant& variant, const VertexShaderParams& params)
+{
+	std::vector<unsigned char> blob(WaveBlockLayout::size(params.wave_count), 0);
+
+	auto put = [&](size_t at, auto value)
+	{
+		std::memcpy(blob.data() + at, &value, sizeof value);
+	};
+
+	auto put_waves = [&](size_t count_at, size_t params_at, const std::vector<Wave>& waves)
+	{
+		const size_t count = std::min(waves.size(), size_t(std::max(params.wave_count, 0)));
+		if (count < waves.size())
+		{
+			std::cerr << "[pack_wave_block] " << waves.size() << " waves do not fit in " << params.wave_count << " slots, the rest is dropped\n";
+		}
+
+		put(count_at, int32_t(count));
+		for (size_t i = 0; i < count; i++)
+		{
+			const size_t base = params_at + i * WaveBlockLayout::params_stride;
+			put(base + WaveBlockLayout::amplitude, float(waves[i].amplitude));
+			put(base + WaveBlockLayout::offset, float(waves[i].offset));
+			put(base + WaveBlockLayout::frequency, int32_t(waves[i].frequency_index));
+			put(base + WaveBlockLayout::time_multiplier, float(waves[i].time_multiplier));
+			put(base + WaveBlockLayout::periodic_function, int32_t(waves[i].function_to_use));
+			put(base + WaveBlockLayout::direction, int32_t(waves[i].direction == Wave::Direction::Y ? 1 : 0));
+		}
+	};
+
+	put_waves(WaveBlockLayout::first_count, WaveBlockLayout::first_params, variant.first);
+	put_waves(WaveBlockLayout::second_count, WaveBlockLayout::second_params(params.wave_count), variant.second);
+	return blob;
+}
+
+// The uniform-buffer counterpart of Wave::write: the same sum, looped over the block
+inline void write_uniform_wave_sum(Writer_::Writer& w, const std::string& name)
+{
+	w.lines
+	(
+		"float ${NAME} = 0.0f;\n"
+		"for (int i = 0; i < ${NAME}_count; i++)\n"
+		"{\n"
+		"    WaveParams p = ${NAME}_params[i];\n"
+		"    float rnd = p.direction == 0 ? rnd_x : rnd_y;\n"
+		"    float t = uTime * p.time_multiplier;\n"
+		"    ${NAME} += p.amplitude * f_periodic(p.periodic_function, f_adjust_to_two_pi(p.offset + rnd * TAU * p.frequency + t * uTime));\n"
+		"}\n",
+		{ {"NAME", name} }
+	);
+
+	w.blank();
+	w.linef("{} *= float({});", name, 0.2f);
+}
+
+
+
+// Emits the instanced-cubes vertex shader into w (randomized via Random::engine()).
+// With sections, the parts that never change are rendered once and reused from it; report
+// collects the operation counts of params.optimize_expressions.
+inline void write_vertex_shader(Writer_::Writer& w, Writer_::SectionCache* sections = nullptr, const VertexShaderParams& params = {},
+	Expr::Report* report = nullptr)
+{
+
+	// Generate Header
+	w.section(sections, "header", Writer_::SectionCache::hash_inputs(), [](Writer_::Writer& w)
+	{
+		w.line("#version 450 core");
+		w.line("layout(location = 0) in vec3 aPos;");
+		w.line("layout(location = 1) in vec2 aTexCoord;");
+		w.blank();
+
+
+		w.comment("outputs to fragment");
+		w.line("out vec2 TexCoord;");
+		w.line("out vec3 color_vs;");
+		w.line("out vec3 vWorldPos;");
+		w.line("out vec3 vNormal;");
+		w.blank();
+
+		w.comment("uniforms");
+		w.line("uniform mat4 model;       // can be identity");
+		w.line("uniform mat4 view;");
+		w.line("uniform mat4 projection;");
+		w.line("uniform ivec3 uGrid;      // number of instances along X,Y,Z (instanceCount = X*Y*Z)");
+		w.line("uniform float uSpacing;   // distance between grid cells"); // we are not using this
+		w.line("uniform vec3  uOrigin;    // base world offset");
+		w.line("uniform vec3  uScaleMin;  // min scale per axis");
+		w.line("uniform vec3  uScaleMax;  // max scale per axis");
+		w.line("uniform float uTime;      // time (seconds)");
+		w.line("uniform float uRotSpeed;  // radians/sec");
+		w.line("uniform uint  uSeed;      // global random seed");
+		w.blank();
+		w.line("uniform uint uDrawcallNumber;");
+		w.line("uniform vec3 uCameraPos;");
+		w.line("uniform float u0, u1, u2, u3, u4, u5, u6, u7, u8, u9;");
+		w.blank();
+
+		w.comment("// ---------- Constants & tiny helpers ----------");
+		w.line("const float PI = 3.1415926535897932384626433832795;");
+		w.line("const float TAU = 6.2831853071795864769252867665590;");
+		w.blank();
+
+		w.line("float saturate(float x) { return clamp(x, 0.0, 1.0); }");
+		w.blank();
+
+		w.lines(R"GLSL(
+uint pcg_hash(uint x) {
+    x = x * 747796405u + 2891336453u;
+    x = ((x >> ((x >> 28u) + 4u)) ^ x) * 277803737u;
+    x = (x >> 22u) ^ x;
+    return x;
+}
+)GLSL", {});
+		w.blank();
+
+		w.line("float rand01(inout uint s) { s = pcg_hash(s); return float(s) * (1.0 / 4294967295.0); }");
+		w.blank();
+
+		w.lines(R"GLSL(
+vec3 spherical01(float r, float theta01, float phi01) {
+    float theta = theta01 * TAU; // azimuth
+    float phi = phi01 * PI;   // polar
+    float sphi = sin(phi);
+    return vec3(r * sphi * cos(theta), r * cos(phi), r * sphi * sin(theta));
+}
+)GLSL", {});
+		w.blank();
+
+		w.lines(R"GLSL(
+mat3 axisAngleToMat3(vec3 axis, float a) {
+    float c = cos(a), s = sin(a);
+    vec3 t = (1.0 - c) * axis;
+    return mat3(
+        t.x * axis.x + c, t.x * axis.y - s * axis.z, t.x * axis.z + s * axis.y,
+        t.y * axis.x + s * axis.z, t.y * axis.y + c, t.y * axis.z - s * axis.x,
+        t.z * axis.x - s * axis.y, t.z * axis.y + s * axis.x, t.z * axis.z + c
+    );
+}
+)GLSL", {});
+		w.blank();
+
+		w.lines(R"GLSL(
+// Axis-aligned cube face normal from aPos (local space)
+vec3 localCubeFaceNormal(vec3 p) {
+    vec3 ap = abs(p);
+    if (ap.x >= ap.y && ap.x >= ap.z) return vec3(sign(p.x), 0.0, 0.0);
+    if (ap.y >= ap.x && ap.y >= ap.z) return vec3(0.0, sign(p.y), 0.0);
+    return vec3(0.0, 0.0, sign(p.z));
+}
+)GLSL", {});
+		w.blank();
+	});
+
+	if (params.uniform_waves)
+	{
+		write_wave_block_declaration(w, params);
+	}
+
+	// The periodic functions
+	w.section(sections, "periodic_functions", Writer_::SectionCache::hash_inputs(), [](Writer_::Writer& w)
+	{
+		w.lines(R"GLSL(
+// 0 to 1
+float f_periodic_0(float x)
+{
+    return 2.0 * abs(fract(x + 0.5) - 0.5);
+}
+
+// Square Wave 
+float f_periodic_1(float x)
+{
+    return  floor(x) - floor(x - 0.5);
+}
+
+// The Bouncing Ball (Parabolic Arches)
+float f_periodic_2(float x)
+{
+    return 4 * fract(x) * (1 - fract(x));
+}
+
+float f_periodic_3(float x)
+{
+    return exp(-30 * ((fract(x + 0.5) - 0.5) * (fract(x + 0.5) - 0.5)));
+}
+
+float f_periodic_4(float x)
+{
+    return abs(0.7 * cos(2 * PI * x) + 0.3 * cos(6 * PI * x)) * (-1.0) + 1.0;
+}
+
+float f_periodic_5(float x)
+{ 
+    return 1.0 - abs(round(10 * fract(x)) / 10 - 0.5) * 2.0;
+}
+
+float f_periodic_6(float x)
+{
+    return sqrt(4 * fract(x) * (1 - fract(x)));
+}
+
+float f_periodic_7(float x)
+{
+    return sin(5 * PI * fract(x)) * (1 - fract(x));
+}
+
+// 1) Raised-cosine (Hann) arch  smooth & band-limited-ish
+float f_periodic_8(float x)
+{
+    return 0.5 - 0.5 * cos(TAU * x);               // 0 at integers, 1 at half-integers
+}
+
+float f_periodic_9(float x)
+{
+    return pow(2.0 * abs(fract(x + 0.5) - 0.5), 1.5);
+}
+
+float f_periodic_10(float x)
+{
+    return (abs(1.0 / (1.0 + exp(-6.0 * sin(TAU * x))) - 0.5)) * 2.0 * 2.0 * abs(fract(x + 0.5) - 0.5);
+}
+
+float f_periodic_11(float x)
+{
+    return fract(x) * fract(x) * (3.0 - 2.0 * fract(x)) * 2.0 * abs(fract(x + 0.5) - 0.5) * 1.9;
+}
+
+float f_adjust_to_two_pi(float x)
+{
+    return x * (1.0 / TAU);
+}
+)GLSL", {});
+		w.blank();
+	});
+
+	// Run-time pick of the periodic function a uniform-buffer wave names
+	if (params.uniform_waves)
+	{
+		w.section(sections, "periodic_dispatch", Writer_::SectionCache::hash_inputs(), [](Writer_::Writer& w)
+		{
+			w.line("float f_periodic(int fn, float x)");
+			w.open("{");
+			w.line("switch (fn)");
+			w.open("{");
+			for (int i = 0; i < 11; i++)
+			{
+				w.linef("case {}: return f_periodic_{}(x);", i, i);
+			}
+			w.line("default: return f_periodic_11(x);");
+			w.close("}");
+			w.close("}");
+			w.blank();
+		});
+	}
+
+	
+
+
+	// wave_0() bakes its own random constants and main() never calls it, so the uniform-buffer
+	// shader, which has to stay the same for every variant, leaves it out
+	if (!params.uniform_waves)
+	{
+		w.blank();
+		w.comment("wave functions");
+
+		/*
+		vec3 wave_0(float x, float y, float t)
+		{
+			return vec3(0.0, 0.0, 0.0);
+		}
+		*/
+
+		class CreateWave_N0
+		{
+		public:
+			bool first = true;
+
+			CreateWave_N0()
+			{
+
+			}
+
+
+			void write(Writer_::Writer& w)
+			{
+				const int index = first ? 0 : 1;
+
+				w.linef("vec3 wave_{}(float x, float y, float t)", index);
+				w.open("{");
+
+				w.blank();
+				w.line("float offset_x = 0.0;");
+				w.line("float offset_y = 0.0;");
+
+				{
+					struct Wave
+					{
+						float amplitude;
+						int frequency;
+						float offset;
+						float time_multiplier;
+
+						float color_r;
+						float color_g;
+						float color_b;
+					};
+
+					std::vector<Wave> waves_x;
+					std::vector<Wave> waves_y;
+
+					{
+						// generate
+
+						for (int i = 0; i < 10; i++)
+						{
+							{
+								float amplitude = Random::generate_random_float_0_to_1();
+								int frequency = Random::random_int(1, 10);
+								float offset = Random::generate_random_float_0_to_1();
+								float time_multiplier = 0.01;
+
+								float color_r = Random::generate_random_float_0_to_1() * 0.2;
+								float color_g = Random::generate_random_float_0_to_1() * 0.2;
+								float color_b = Random::generate_random_float_0_to_1() * 0.2;
+
+								waves_x.push_back({ amplitude, frequency, offset , time_multiplier , color_r, color_g, color_b });
+							}
+
+							{
+								float amplitude = Random::generate_random_float_0_to_1();
+								int frequency = Random::random_int(1, 10);
+								float offset = Random::generate_random_float_0_to_1();
+								float time_multiplier = 0.01;
+
+								float color_r = Random::generate_random_float_0_to_1() * 0.2;
+								float color_g = Random::generate_random_float_0_to_1() * 0.2;
+								float color_b = Random::generate_random_float_0_to_1() * 0.2;
+
+								waves_y.push_back({ amplitude, frequency, offset , time_multiplier , color_r, color_g, color_b });
+							}
+						}
+
+						// normalize
+
+						{
+							// waves_x
+							{
+								int num = waves_x.size();
+
+								float amplitude_sum = 0.0;
+								float color_r_sum = 0.0;
+								float color_g_sum = 0.0;
+								float color_b_sum = 0.0;
+
+								for (int i = 0; i < num; i++)
+								{
+									const Wave& wave = waves_x.at(i);
+									amplitude_sum += wave.amplitude;
+									color_r_sum += wave.color_r;
+									color_g_sum += wave.color_g;
+									color_b_sum += wave.color_b;
+								}
+
+								float factor_amplitude = 1.0;
+
+								if (amplitude_sum > 1.0)
+								{
+									factor_amplitude = 1.0 / amplitude_sum;
+								}
+
+								float factor_color_r = 1.0;
+
+								if (color_r_sum > 1.0)
+								{
+									factor_color_r = 1.0 / color_r_sum;
+								}
+
+								float factor_color_g = 1.0;
+
+								if (color_g_sum > 1.0)
+								{
+									factor_color_g = 1.0 / color_g_sum;
+								}
+
+								float factor_color_b = 1.0;
+
+								if (color_b_sum > 1.0)
+								{
+									factor_color_b = 1.0 / color_b_sum;
+								}
+
+
+								for (Wave& wave : waves_x)
+								{
+									wave.amplitude *= factor_amplitude;
+									wave.color_r *= factor_color_r;
+									wave.color_g *= factor_color_g;
+									wave.color_b *= factor_color_b;
+								}
+
+
+
+
+								
+							}
+							
+						}
+
+					}
+
+
+					// All ten terms go out as one batch; the draws stay in the same order
+					Writer_::Table terms({ "AMPLITUDE_X", "FREQUENCY_X", "OFFSET_X", "AMPLITUDE_Y", "FREQUENCY_Y", "OFFSET_Y" });
+					terms.reserve(10);
+					for (int i = 0; i < 10; i++)
+					{
+						float amplitude_x = Random::generate_random_float_0_to_1();
+						int frequency_x = Random::random_int(1, 10);
+						float offset_x = Random::generate_random_float_0_to_1();
+
+						float amplitude_y = Random::generate_random_float_0_to_1();
+						int frequency_y = Random::random_int(1, 10);
+						float offset_y = Random::generate_random_float_0_to_1();
+
+						terms.add_row({ amplitude_x, float(frequency_x), offset_x, amplitude_y, float(frequency_y), offset_y });
+
+						// first_wave y 0 
+						// int first_wave_0_y_frequency = int(4);
+						// float first_wave_0_y_offset = float(-4.354416);
+						// float first_wave_0_y_amplitude = float(0.0384163);
+						// float first_wave_0_y_t = uTime * float(-0.0042715347);
+
+						//float offset = 0.0;
+						//offset += amplitude * sin(frequency * x + offset)
+
+					}
+
+					w.lines_batch
+					(
+						"offset_x += float(${AMPLITUDE_X}) * sin(float(${FREQUENCY_X}) * x + float(${OFFSET_X}));\n"
+						"offset_y += float(${AMPLITUDE_Y}) * sin(float(${FREQUENCY_Y}) * x + float(${OFFSET_Y}));",
+						terms
+					);
+				}
+
+				
+
+				w.blank();
+				w.line("float offset = offset_x + offset_y;");
+
+				// x
+				// amplitude
+				// frequency
+				// offset
+
+				// y
+				// amplitude
+				// frequency
+				// offset
+
+				// color_r
+				// color_g
+				// color_b
+
+				w.line("");
+				w.line("return vec3(0.0, 0.0, 0.0);");
+				w.close("}");
+				w.blank();
+			}
+
+		
+		};
+
+		CreateWave_N0 wave;
+		wave.first = true;
+		wave.write(w);
+
+	}
+
+	w.line("void main()");
+	w.open("{");
+
+	w.section(sections, "main_prologue", Writer_::SectionCache::hash_inputs(), [](Writer_::Writer& w)
+	{
+		w.line("int id = gl_InstanceID;");
+		w.blank();
+
+		w.line("id =  id + (uGrid.x * uGrid.y * uGrid.z) * int(uDrawcallNumber);");
+		w.blank();
+
+		w.lines(R"GLSL(
+// Per-instance randomness
+    uint s0 = uSeed + uint(id + 0);
+    uint s1 = uSeed + uint(id + 42);
+    uint s2 = uSeed + uint(id + 142);
+    float rnd_x = rand01(s0);
+    float rnd_y = rand01(s1);
+    float rnd_z = rand01(s2);
+
+    // The instancd cube rotation randomization
+    uint s0_rot_x = uSeed + uint(id + 2431);
+    uint s1_rot_y = uSeed + uint(id + 4412);
+    uint s2_rot_y = uSeed + uint(id + 1234);
+    uint s3_rot_angle = uSeed + uint(id + 2332);
+    float rnd_cube_rotation_x = rand01(s0_rot_x);
+    float rnd_cube_rotation_y = rand01(s1_rot_y);
+    float rnd_cube_rotation_z = rand01(s2_rot_y);
+    float rnd_cube_rotation_angle = rand01(s3_rot_angle);
+)GLSL", {});
+		w.blank();
+	});
+
+	{
+		std::string name_0 = WaveBlockLayout::names[0];
+		std::string name_1 = WaveBlockLayout::names[1];
+
+
+		if (params.uniform_waves)
+		{
+			write_uniform_wave_sum(w, name_0);
+			w.blank();
+			write_uniform_wave_sum(w, name_1);
+			w.blank();
+		}
+		// Same seeds and threads as below, but the two sums are emitted from one expression program
+		else if (params.optimize_expressions)
+		{
+			std::vector<Wave> waves[2];
+
+			const unsigned seed_0 = Random::engine()();
+			const unsigned seed_1 = Random::engine()();
+
+			run_wave_blocks(params.parallel_blocks,
+				[&] { waves[0] = generate_wave_block(seed_0, params.wave_count); },
+				[&] { waves[1] = generate_wave_block(seed_1, params.wave_count); });
+
+			const std::string names[2] = { name_0, name_1 };
+			Wave::write_optimized(w, names, waves, report);
+		}
+		// The two wave blocks are independent: each is generated into a child Writer on
+		// its own thread (unless params.parallel_blocks is off) and spliced back in order.
+		// Seeds come from this thread's engine so the output only depends on it, not on scheduling.
+		else
+		{
+			auto wave_block = [&params](Writer_::Writer& out, const std::string& name, unsigned seed)
+			{
+				std::vector<Wave> waves = generate_wave_block(seed, params.wave_count);
+
+				Wave::write(out, waves, name);
+
+				out.blank();
+			};
+
+			Writer_::Writer block_0 = w.child();
+			Writer_::Writer block_1 = w.child();
+
+			const unsigned seed_0 = Random::engine()();
+			const unsigned seed_1 = Random::engine()();
+
+			run_wave_blocks(params.parallel_blocks,
+				[&] { wave_block(block_0, name_0, seed_0); },
+				[&] { wave_block(block_1, name_1, seed_1); });
+
+			w.splice(std::move(block_0));
+			w.splice(std::move(block_1));
+		}
+
+
+		{
+			w.line("float f_0 = fract(uTime * 0.1);");
+			w.line("float f_1 = 1.0 - f_0;");
+			w.blank();
+			w.line(Writer_::Template<"float w = f_1 * ${NAME_0} + f_0 * ${NAME_1};">{}, Writer_::arg<"NAME_0">(name_0), Writer_::arg<"NAME_1">(name_1));
+
+
+		}
+
+	}
+
+
+	w.blank();
+
+	w.section(sections, "main_epilogue", Writer_::SectionCache::hash_inputs(), [](Writer_::Writer& w)
+	{
+		w.line("float radius = 0.2 + w;");
+
+		w.lines(R"GLSL(
+// Sphere
+    vec3 sphere_position = spherical01(radius, rnd_x, rnd_y);
+    float px = sphere_position.x;
+    float py = sphere_position.y;
+    float pz = sphere_position.z;
+
+    float color_r = 0.01;
+    float color_g = 0.01;
+    float color_b = 0.01;
+
+    
+    // Instances Cube Scale
+    float scale_cube = 0.001;
+    vec3  pos = vec3(px, pz, py);
+    vec3  scale = vec3(scale_cube, scale_cube, scale_cube);
+
+
+    // Whole object rotation
+
+    vec3 rotation_axis = vec3(0.0, 1.0, 0.0);
+    float rotation_angle = uTime; // using uTime will not be wise after we will be interpolating between two values
+
+    // Whole object scale
+    vec3 scale_object = vec3(1.0, 1.0, 1.0);
+
+    
+
+    vec4 new_position = vec4(vec3(pos), 1.0);
+
+    if (true) {
+
+        uint s0_instance_0 = uSeed + uint(uint(u0 * 1000.0f));
+        uint s0_instance_1 = uSeed + uint(uint(u0 * 1421.0f));
+        float rnd_instance_0 = rand01(s0_instance_0);
+        float rnd_instance_1 = rand01(s0_instance_1);
+
+        uint s0_instance_x_scale = uSeed + uint(uint(u0 * 14024.0f));
+        uint s0_instance_y_scale = uSeed + uint(uint(u0 * 15214.0f));
+        uint s0_instance_z_scale = uSeed + uint(uint(u0 * 14215.0f));
+        float rnd_instance_scale_x = rand01(s0_instance_x_scale);
+        float rnd_instance_scale_y = rand01(s0_instance_y_scale);
+        float rnd_instance_scale_z = rand01(s0_instance_z_scale);
+
+        // Rotation
+        // vec3 axis = normalize(vec3(0.0, 1.0, 1.0));
+        vec3 axis = normalize(rotation_axis);
+        // float angle = uTime;
+        float angle = rotation_angle;
+        mat3 R3 = axisAngleToMat3(axis, angle);
+        mat4 R = mat4(vec4(R3[0], 0.0), vec4(R3[1], 0.0), vec4(R3[2], 0.0), vec4(0, 0, 0, 1));
+
+        // Translation
+        mat4 T = mat4(1.0);
+        vec3 offset = vec3(sin(uTime + rnd_instance_0 * 10.0) * 10.0, sin(uTime + rnd_instance_1 * 0.0) * 10.0, 0.0);
+        offset = vec3(0.5, 0.5, 0.5);
+        T[3] = vec4(offset, 1.0);
+
+
+
+        // Scale
+        mat4 S = mat4(1.0);
+        S[0][0] = scale_object.x;
+        S[1][1] = scale_object.y;
+        S[2][2] = scale_object.z;
+
+        new_position = T * R * S * new_position;
+    }
+
+
+
+    pos = new_position.xyz;
+    
+
+
+
+
+
+    
+    // Per-instance tint (kept neutral here)
+    color_vs = vec3(color_r, color_g, color_b);
+
+    // Build TRS
+    mat4 T = mat4(1.0); T[3] = vec4(pos, 1.0);
+    vec3 axis = normalize(vec3(rnd_cube_rotation_x, rnd_cube_rotation_y, rnd_cube_rotation_z));
+    float angle = rnd_cube_rotation_angle;//uTime * 0.0;
+    mat3 R3 = axisAngleToMat3(axis, angle);
+    mat4 R = mat4(vec4(R3[0], 0.0), vec4(R3[1], 0.0), vec4(R3[2], 0.0), vec4(0, 0, 0, 1));
+    mat4 S = mat4(1.0); S[0][0] = scale.x; S[1][1] = scale.y; S[2][2] = scale.z;
+
+    mat4 instanceModel = T * R * S;
+    mat4 M = model * instanceModel;
+
+    // World-space position (for lighting)
+    vec4 wp = M * vec4(aPos, 1.0);
+    vWorldPos = wp.xyz;
+
+    // World-space normal:
+    // Fast path (assumes uniform scale): rotate the face normal by model rotation and R3.
+    // If you later use non-uniform model scale, switch to normal matrix:
+    //   mat3 N = transpose(inverse(mat3(M)));
+    //   vNormal = normalize(N * nLocal);
+    vec3 nLocal = localCubeFaceNormal(aPos);
+    vNormal = normalize(mat3(model) * (R3 * nLocal)); // uniform-scale assumption
+
+    // Clip-space position and UV
+    gl_Position = projection * view * wp;
+    TexCoord = aTexCoord;
+
+
+    // World position color
+
+    // float world_x = wp.x;
+    // float world_y = wp.y;
+    // float world_z = wp.z;
+    // color_vs = vec3(sin(world_x * 10.0), sin(world_y * 10.0), sin(world_z * 10.0)) * vec3(0.01, 0.01, 0.01);
+)GLSL", {});
+	});
+
+	w.close("}");
+}
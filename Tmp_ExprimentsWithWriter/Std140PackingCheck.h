@@ -0,0 +1,224 @@
+#pragma once
+
+#include "ShaderGenerator.h"
+#include "SelfCheck.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+
+
+
+
+// CPU-side check of the uniform-buffer shader mode: the WaveBlock declaration the generator
+// emits is laid out with an independent std140 calculator, and that layout has to agree with
+// WaveBlockLayout and with the bytes pack_wave_block produces. No GL context needed.
+namespace Std140Check
+{
+	struct Type
+	{
+		size_t align = 0;
+		size_t size = 0;
+		std::map<std::string, size_t> members;   // struct types only: member offsets
+	};
+
+	static size_t round_up(size_t x, size_t a) { return (x + a - 1) / a * a; }
+
+	// Just enough std140 (GLSL 4.50 spec, 7.6.2.2) for scalars, vectors, arrays and structs
+	struct Layout
+	{
+		std::map<std::string, Type> types =
+		{
+			{ "int", { 4, 4, {} } }, { "uint", { 4, 4, {} } }, { "float", { 4, 4, {} } }, { "bool", { 4, 4, {} } },
+			{ "vec2", { 8, 8, {} } }, { "ivec2", { 8, 8, {} } },
+			{ "vec3", { 16, 12, {} } }, { "ivec3", { 16, 12, {} } },
+			{ "vec4", { 16, 16, {} } }, { "ivec4", { 16, 16, {} } },
+		};
+
+		// Members as "type name;" or "type name[N];" lines; returns the aggregate (struct rules)
+		bool lay_out(const std::vector<std::string>& lines, Type& out, std::string& error)
+		{
+			size_t at = 0;
+			size_t max_align = 0;
+			for (const std::string& line : lines)
+			{
+				std::istringstream in(line.substr(0, line.find(';')));
+				std::string type_name, name;
+				if (!(in >> type_name >> name)) continue;
+
+				auto type = types.find(type_name);
+				if (type == types.end())
+				{
+					error = "unknown type " + type_name;
+					return false;
+				}
+
+				size_t align = type->second.align;
+				size_t size = type->second.size;
+
+				const size_t bracket = name.find('[');
+				if (bracket != std::string::npos)
+				{
+					const size_t count = std::stoul(name.substr(bracket + 1));
+					name.resize(bracket);
+					align = round_up(align, 16);                      // rule 4: array elements align like vec4
+					size = round_up(type->second.size, 16) * count;   // and the stride rounds up to it
+				}
+
+				at = round_up(at, align);
+				out.members[name] = at;
+				at += size;
+				max_align = std::max(max_align, align);
+			}
+
+			out.align = round_up(max_align, 16);   // rule 9: structs align like vec4
+			out.size = round_up(at, out.align);    // and are padded to that
+			return true;
+		}
+	};
+
+	// The member lines between "<head>" and the closing "};"
+	static std::vector<std::string> block_body(const std::string& glsl, const std::string& head)
+	{
+		std::vector<std::string> lines;
+		const size_t start = glsl.find(head);
+		if (start == std::string::npos) return lines;
+
+		std::istringstream in(glsl.substr(glsl.find('{', start) + 1));
+		std::string line;
+		while (std::getline(in, line) && line.find("};") == std::string::npos)
+		{
+			lines.push_back(line);
+		}
+		return lines;
+	}
+
+	template<class T>
+	static T read(const std::vector<unsigned char>& blob, size_t at)
+	{
+		T value{};
+		std::memcpy(&value, blob.data() + at, sizeof value);
+		return value;
+	}
+
+	using SelfCheck::Report;
+
+	static void check_layout_rules(Report& report)
+	{
+		// Known answers, to make sure the checker itself follows std140
+		Layout layout;
+		Type block;
+		std::string error;
+		layout.lay_out({ "vec3 a;", "float b;", "float c[2];", "vec2 d;", "int e;" }, block, error);
+		report.expect(block.members["b"] == 12, "float after vec3 packs into its last 4 bytes");
+		report.expect(block.members["c"] == 16, "float array aligns to 16");
+		report.expect(block.members["d"] == 48, "float[2] takes a 16 byte stride per element");
+		report.expect(block.members["e"] == 56, "int after vec2");
+		report.expect(block.size == 64, "struct size rounds up to 16");
+	}
+
+	static void check_wave_block(Report& report, const VertexShaderParams& params, unsigned seed)
+	{
+		const std::string tag = " (wave_count " + std::to_string(params.wave_count) + ")";
+
+		Writer_::Writer w;
+		write_wave_block_declaration(w, params);
+		const std::string glsl(w.view());
+
+		Layout layout;
+		std::string error;
+		Type wave_params;
+		Type block;
+		if (!layout.lay_out(block_body(glsl, "struct WaveParams"), wave_params, error))
+		{
+			report.expect(false, "WaveParams: " + error);
+			return;
+		}
+		layout.types["WaveParams"] = wave_params;
+		if (!layout.lay_out(block_body(glsl, "uniform WaveBlock"), block, error))
+		{
+			report.expect(false, "WaveBlock: " + error);
+			return;
+		}
+
+		const std::string first = WaveBlockLayout::names[0];
+		const std::string second = WaveBlockLayout::names[1];
+
+		report.expect(wave_params.members["amplitude"] == WaveBlockLayout::amplitude, "amplitude offset" + tag);
+		report.expect(wave_params.members["offset"] == WaveBlockLayout::offset, "offset offset" + tag);
+		report.expect(wave_params.members["frequency"] == WaveBlockLayout::frequency, "frequency offset" + tag);
+		report.expect(wave_params.members["time_multiplier"] == WaveBlockLayout::time_multiplier, "time_multiplier offset" + tag);
+		report.expect(wave_params.members["periodic_function"] == WaveBlockLayout::periodic_function, "periodic_function offset" + tag);
+		report.expect(wave_params.members["direction"] == WaveBlockLayout::direction, "direction offset" + tag);
+		report.expect(wave_params.size == WaveBlockLayout::params_stride, "WaveParams stride" + tag);
+
+		report.expect(block.members[first + "_count"] == WaveBlockLayout::first_count, "first count offset" + tag);
+		report.expect(block.members[second + "_count"] == WaveBlockLayout::second_count, "second count offset" + tag);
+		report.expect(block.members[first + "_params"] == WaveBlockLayout::first_params, "first params offset" + tag);
+		report.expect(block.members[second + "_params"] == WaveBlockLayout::second_params(params.wave_count), "second params offset" + tag);
+		report.expect(block.size == WaveBlockLayout::size(params.wave_count), "block size" + tag);
+
+		// The bytes of a packed variant, read back through the independently computed offsets
+		Random::set_seed(seed);
+		const WaveVariant variant = generate_wave_variant(params);
+		const std::vector<unsigned char> blob = pack_wave_block(variant, params);
+		report.expect(blob.size() == block.size, "packed size" + tag);
+		if (blob.size() != block.size) return;
+
+		std::vector<bool> written(blob.size(), false);
+		auto mark = [&](size_t at, size_t n) { for (size_t i = 0; i < n; i++) written[at + i] = true; };
+
+		auto check_waves = [&](const std::string& name, const std::vector<Wave>& waves)
+		{
+			const size_t count_at = block.members[name + "_count"];
+			report.expect(read<int32_t>(blob, count_at) == int32_t(waves.size()), name + " count" + tag);
+			mark(count_at, 4);
+
+			for (size_t i = 0; i < waves.size(); i++)
+			{
+				const size_t base = block.members[name + "_params"] + i * wave_params.size;
+				auto field = [&](const char* member) { const size_t at = base + wave_params.members[member]; mark(at, 4); return at; };
+
+				const std::string where = name + "[" + std::to_string(i) + "].";
+				report.expect(read<float>(blob, field("amplitude")) == waves[i].amplitude, where + "amplitude" + tag);
+				report.expect(read<float>(blob, field("offset")) == waves[i].offset, where + "offset" + tag);
+				report.expect(read<int32_t>(blob, field("frequency")) == waves[i].frequency_index, where + "frequency" + tag);
+				report.expect(read<float>(blob, field("time_multiplier")) == waves[i].time_multiplier, where + "time_multiplier" + tag);
+				report.expect(read<int32_t>(blob, field("periodic_function")) == waves[i].function_to_use, where + "periodic_function" + tag);
+				report.expect(read<int32_t>(blob, field("direction")) == (waves[i].direction == Wave::Direction::Y ? 1 : 0), where + "direction" + tag);
+			}
+		};
+
+		check_waves(first, variant.first);
+		check_waves(second, variant.second);
+
+		size_t dirty_padding = 0;
+		for (size_t i = 0; i < blob.size(); i++)
+		{
+			if (!written[i] && blob[i] != 0) dirty_padding++;
+		}
+		report.expect(dirty_padding == 0, "padding bytes are zero" + tag);
+	}
+}
+
+int main()
+{
+	std::cout << "Std140PackingCheck\n";
+
+	Std140Check::Report report;
+	Std140Check::check_layout_rules(report);
+
+	for (int wave_count : { 1, 3, 20, 64 })
+	{
+		VertexShaderParams params;
+		params.wave_count = wave_count;
+		params.uniform_waves = true;
+		Std140Check::check_wave_block(report, params, 1234u + unsigned(wave_count));
+	}
+
+	std::cout << "  " << report.checks - report.failures << "/" << report.checks << " checks passed\n";
+	return report.failures == 0 ? 0 : 1;
+}
@@ -2,31 +2,111 @@
 
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#if WRITER_INSTRUMENTATION
+#include "CppCommponents/json.h"
+#endif
 #include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WRITER_SCAN_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WRITER_SCAN_SSE2 1
+#endif
 
 namespace Writer_ {
 
     // ctor
-    Writer::Writer(std::string indentUnit)
-        : indentUnit_(std::move(indentUnit)) {
+    Writer::Writer(std::string_view indentUnit, std::pmr::memory_resource* resource)
+        : text_(resource), lineStarts_(resource), chunks_(resource), pool_(resource), poolIndex_(resource),
+          indentUnit_(indentUnit, resource), indentCache_(resource) {
+    }
+
+    Writer::Writer(Sink sink, std::string_view indentUnit, size_t blockSize, std::pmr::memory_resource* resource)
+        : text_(resource), lineStarts_(resource), chunks_(resource), pool_(resource), poolIndex_(resource),
+          indentUnit_(indentUnit, resource), indentCache_(resource), stream_(std::move(sink), blockSize) {
+        text_.reserve(blockSize + blockSize / 4);
+        blockLimit_ = blockSize;
+    }
+
+    Writer::~Writer() { flush(); }
+
+    // sinks
+    Writer::Sink Writer::ostream_sink(std::ostream& os) {
+        return [&os](std::string_view block) { os.write(block.data(), std::streamsize(block.size())); };
+    }
+
+    // Writes all of block, retrying short writes and EINTR
+    static bool write_all(int fd, std::string_view block) {
+        while (!block.empty()) {
+#ifdef _WIN32
+            int n = _write(fd, block.data(), unsigned(std::min<size_t>(block.size(), 1u << 30)));
+#else
+            ssize_t n = ::write(fd, block.data(), block.size());
+#endif
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            block.remove_prefix(size_t(n));
+        }
+        return true;
+    }
+
+    Writer::Sink Writer::fd_sink(int fd) {
+        return [fd](std::string_view block) {
+            if (!write_all(fd, block)) std::cerr << "[Writer] fd_sink write FAILED (errno " << errno << ")\n";
+        };
+    }
+
+    Writer::Sink Writer::file_sink(const std::filesystem::path& filepath) {
+        namespace fs = std::filesystem;
+        if (filepath.has_parent_path()) fs::create_directories(filepath.parent_path());
+        auto out = std::make_shared<std::ofstream>(filepath, std::ios::binary);
+        return [out](std::string_view block) { out->write(block.data(), std::streamsize(block.size())); };
     }
 
     // primitives
-    void Writer::append_raw(const std::string& line) { lines_.push_back(line); }
-    void Writer::append(const std::string& line) { lines_.push_back(indent_prefix() + line); }
-    void Writer::line(const std::string& s) { append(s); }
+    void Writer::append_raw(std::string_view line) {
+        lineStarts_.push_back(text_.size());
+        text_ += line;
+        end_line();
+    }
+    void Writer::append(std::string_view line) { begin_line(); text_ += line; end_line(); }
+    void Writer::line(std::string_view s) { append(s); }
 
     // single-line with replacement
-    bool Writer::line(const std::string& tmpl, const Vars& vars,
+    bool Writer::line(std::string_view tmpl, const VarsView& vars,
+        ReplaceStats* outStats, bool require_any)
+    {
+        return line(compiled(tmpl, CompiledTemplate::Mode::SingleLine), vars, outStats, require_any);
+    }
+
+    bool Writer::line(const CompiledTemplate& tmpl, const VarsView& vars,
         ReplaceStats* outStats, bool require_any)
     {
-        ReplaceStats st;
-        std::string replaced = replace_placeholders(tmpl, vars, st);
-        append(replaced);
+        ReplaceStats st(resource());
+        instantiate(tmpl, vars, "", st);
         if (outStats) *outStats = st;
         if (!st.ok(require_any)) {
-            report_replace_issue("line", tmpl, st, require_any);
+            report_replace_issue("line", tmpl.source(), st, require_any);
             return false;
         }
         return true;
@@ -34,20 +114,23 @@ namespace Writer_ {
 
     // blank lines
     void Writer::blank(size_t n) {
-        while (n--) lines_.push_back("");
+        while (n--) { lineStarts_.push_back(text_.size()); end_line(); }
     }
 
     // comments
-    void Writer::comment(const std::string& s) {
-        append("// " + s);
+    void Writer::comment(std::string_view s) {
+        begin_line();
+        text_ += "// ";
+        text_ += s;
+        end_line();
     }
 
-    bool Writer::comment(const std::string& tmpl, const Vars& vars,
+    bool Writer::comment(std::string_view tmpl, const VarsView& vars,
         ReplaceStats* outStats, bool require_any)
     {
-        ReplaceStats st;
-        std::string replaced = replace_placeholders(tmpl, vars, st);
-        append("// " + replaced);
+        const CompiledTemplate& t = compiled(tmpl, CompiledTemplate::Mode::SingleLine);
+        ReplaceStats st(resource());
+        instantiate(t, vars, "// ", st);
         if (outStats) *outStats = st;
         if (!st.ok(require_any)) {
             report_replace_issue("comment", tmpl, st, require_any);
@@ -56,34 +139,13 @@ namespace Writer_ {
         return true;
     }
 
-    bool Writer::comments(const std::string& tmplMultiline, const Vars& vars,
+    bool Writer::comments(std::string_view tmplMultiline, const VarsView& vars,
         ReplaceStats* outStats, bool require_any)
     {
-        ReplaceStats agg;
-        std::string cur; cur.reserve(tmplMultiline.size());
-
-        auto flush_line = [&](std::string& s) {
-            ReplaceStats st;
-            std::string replaced = replace_placeholders(s, vars, st);
-            append("// " + replaced);
-            agg.placeholders_found += st.placeholders_found;
-            agg.replacements_done += st.replacements_done;
-            agg.missing_placeholders.insert(agg.missing_placeholders.end(),
-                st.missing_placeholders.begin(),
-                st.missing_placeholders.end());
-            };
-
-        for (size_t i = 0; i < tmplMultiline.size(); ++i) {
-            char c = tmplMultiline[i];
-            if (c == '\r') { if (i + 1 < tmplMultiline.size() && tmplMultiline[i + 1] == '\n') continue; }
-            if (c == '\n') { flush_line(cur); cur.clear(); }
-            else { cur.push_back(c); }
-        }
-        if (!cur.empty()) flush_line(cur);
-
-        std::unordered_set<std::string> used;
-        collect_used_placeholders(tmplMultiline, used);
-        for (const auto& kv : vars) if (!used.count(kv.first)) agg.unused_keys.push_back(kv.first);
+        const CompiledTemplate& t = compiled(tmplMultiline, CompiledTemplate::Mode::MultiLine);
+        ReplaceStats agg(resource());
+        instantiate(t, vars, "// ", agg);
+        collect_unused_keys(t, vars, agg);
 
         dedupe_sort(agg.missing_placeholders);
         dedupe_sort(agg.unused_keys);
@@ -97,117 +159,1120 @@ namespace Writer_ {
     }
 
     // multi-line content with replacement
-    bool Writer::lines(const std::string& tmplMultiline, const Vars& vars,
+    bool Writer::lines(std::string_view tmplMultiline, const VarsView& vars,
         ReplaceStats* outStats, bool require_any)
     {
-        ReplaceStats agg;
-        std::string cur; cur.reserve(tmplMultiline.size());
-
-        auto flush_line = [&](std::string& s) {
-            ReplaceStats st;
-            std::string replaced = replace_placeholders(s, vars, st);
-            append(replaced);
-            agg.placeholders_found += st.placeholders_found;
-            agg.replacements_done += st.replacements_done;
-            agg.missing_placeholders.insert(agg.missing_placeholders.end(),
-                st.missing_placeholders.begin(),
-                st.missing_placeholders.end());
-            };
+        return lines(compiled(tmplMultiline, CompiledTemplate::Mode::MultiLine), vars, outStats, require_any);
+    }
+
+    bool Writer::lines(const CompiledTemplate& tmpl, const VarsView& vars,
+        ReplaceStats* outStats, bool require_any)
+    {
+        ReplaceStats agg(resource());
+        instantiate(tmpl, vars, "", agg);
+        collect_unused_keys(tmpl, vars, agg);
 
-        for (size_t i = 0; i < tmplMultiline.size(); ++i) {
-            char c = tmplMultiline[i];
-            if (c == '\r') { if (i + 1 < tmplMultiline.size() && tmplMultiline[i + 1] == '\n') continue; }
-            if (c == '\n') { flush_line(cur); cur.clear(); }
-            else { cur.push_back(c); }
+        dedupe_sort(agg.missing_placeholders);
+        dedupe_sort(agg.unused_keys);
+
+        if (outStats) *outStats = agg;
+        if (!agg.ok(require_any)) {
+            report_replace_issue("lines", tmpl.source(), agg, require_any);
+            return false;
         }
-        if (!cur.empty()) flush_line(cur);
+        return true;
+    }
 
-        std::unordered_set<std::string> used;
-        collect_used_placeholders(tmplMultiline, used);
-        for (const auto& kv : vars) if (!used.count(kv.first)) agg.unused_keys.push_back(kv.first);
+    // batches
+    bool Writer::lines_batch(std::string_view tmplMultiline, const Table& rows, const VarsView& shared,
+        ReplaceStats* outStats, bool require_any)
+    {
+        return lines_batch(compiled(tmplMultiline, CompiledTemplate::Mode::MultiLine), rows, shared, outStats, require_any);
+    }
+
+    bool Writer::lines_batch(const CompiledTemplate& tmpl, const Table& rows, const VarsView& shared,
+        ReplaceStats* outStats, bool require_any)
+    {
+        ReplaceStats agg(resource());
+        instantiate_rows(tmpl, rows, shared, agg);
+        collect_unused_keys(tmpl, shared, agg);
+        for (size_t c = 0; c < rows.columns(); ++c) {
+            const std::string_view name = rows.column_name(c);
+            if (std::find(tmpl.keys().begin(), tmpl.keys().end(), name) == tmpl.keys().end())
+                agg.unused_keys.emplace_back(name);
+        }
 
         dedupe_sort(agg.missing_placeholders);
         dedupe_sort(agg.unused_keys);
 
         if (outStats) *outStats = agg;
         if (!agg.ok(require_any)) {
-            report_replace_issue("lines", tmplMultiline, agg, require_any);
+            report_replace_issue("lines_batch", tmpl.source(), agg, require_any);
             return false;
         }
         return true;
     }
 
     // indentation helpers
-    void Writer::open(const std::string& lineWithBrace) { line(lineWithBrace); ++indentLevel_; }
-    void Writer::close(const std::string& closingBrace) { if (indentLevel_ > 0) --indentLevel_; line(closingBrace); }
+    void Writer::open(std::string_view lineWithBrace) { line(lineWithBrace); ++indentLevel_; }
+    void Writer::close(std::string_view closingBrace) { if (indentLevel_ > 0) --indentLevel_; line(closingBrace); }
 
     // io / utils
     void Writer::print() const { write_to(std::cout); }
 
     void Writer::write_to(std::ostream& os) const {
-        for (const auto& l : lines_) os << l << '\n';
+        WRITER_METRIC(MetricsScope timing(metrics_.io_ns, ioDepth_);)
+        for_each_chunk([&](std::string_view c) { os.write(c.data(), std::streamsize(c.size())); });
+    }
+
+    bool Writer::write_to(int fd) const {
+        WRITER_METRIC(MetricsScope timing(metrics_.io_ns, ioDepth_);)
+#ifdef _WIN32
+        bool ok = true;
+        for_each_chunk([&](std::string_view c) { if (ok) ok = write_all(fd, c); });
+        return ok;
+#else
+        // One iovec per chunk: an unspliced document is a single write, a spliced one
+        // still goes out in one writev per IOV_MAX fragments.
+        std::vector<iovec> iov;
+        iov.reserve(chunks_.size() + 1);
+        for_each_chunk([&](std::string_view c) {
+            if (!c.empty()) iov.push_back({ const_cast<char*>(c.data()), c.size() });
+        });
+
+        size_t first = 0;
+        while (first < iov.size()) {
+            const int count = int(std::min<size_t>(iov.size() - first, IOV_MAX));
+            ssize_t n = ::writev(fd, iov.data() + first, count);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            // Skip what was written; a short write resumes mid-chunk
+            size_t done = size_t(n);
+            while (first < iov.size() && done >= iov[first].iov_len) done -= iov[first++].iov_len;
+            if (done) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + done;
+                iov[first].iov_len -= done;
+            }
+        }
+        return true;
+#endif
+    }
+
+    // Unformatted descriptor output: no iostream buffer or locale between the chunks and the kernel
+    bool Writer::write_file(const std::filesystem::path& filepath) const {
+        WRITER_METRIC(MetricsScope timing(metrics_.io_ns, ioDepth_);)
+#ifdef _WIN32
+        int fd = _wopen(filepath.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        int fd = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+        if (fd < 0) return false;
+        bool ok = write_to(fd);
+#ifdef _WIN32
+        ok = _close(fd) == 0 && ok;
+#else
+        ok = ::close(fd) == 0 && ok;
+#endif
+        return ok;
     }
 
     void Writer::save(const std::filesystem::path& filepath) const {
+        if (streaming()) {
+            std::cerr << "[Writer] save is not available in streaming mode (" << filepath.string() << ")\n";
+            return;
+        }
         namespace fs = std::filesystem;
         if (filepath.has_parent_path()) fs::create_directories(filepath.parent_path());
-        std::ofstream out(filepath, std::ios::binary);
-        for (const auto& l : lines_) out << l << '\n';
+        if (!write_file(filepath)) std::cerr << "[Writer] save " << filepath.string() << " FAILED (errno " << errno << ")\n";
+    }
+
+    Writer::SaveResult Writer::save_if_changed(const std::filesystem::path& filepath) const {
+        WRITER_METRIC(MetricsScope timing(metrics_.io_ns, ioDepth_);)
+        namespace fs = std::filesystem;
+        if (streaming()) {
+            std::cerr << "[Writer] save_if_changed is not available in streaming mode (" << filepath.string() << ")\n";
+            return SaveResult::Failed;
+        }
+
+        std::error_code ec;
+        const size_t bytes = byte_size();
+        if (fs::is_regular_file(filepath, ec) && fs::file_size(filepath, ec) == bytes && !ec) {
+            std::ifstream in(filepath, std::ios::binary);
+            bool same = static_cast<bool>(in);
+            char buf[64 * 1024];
+            for_each_chunk([&](std::string_view c) {
+                while (same && !c.empty()) {
+                    const size_t n = std::min(c.size(), sizeof(buf));
+                    same = static_cast<bool>(in.read(buf, std::streamsize(n))) && std::memcmp(buf, c.data(), n) == 0;
+                    c.remove_prefix(n);
+                }
+            });
+            if (same) return SaveResult::Unchanged;
+        }
+
+        if (filepath.has_parent_path()) fs::create_directories(filepath.parent_path(), ec);
+
+        static std::atomic<uint64_t> counter{ 0 };
+        const uint64_t unique = std::hash<std::thread::id>{}(std::this_thread::get_id()) ^ (counter++ << 32);
+        fs::path tmp = filepath;
+        tmp += ".tmp" + std::to_string(unique);
+        if (!write_file(tmp)) {
+            std::cerr << "[Writer] save_if_changed: writing " << tmp.string() << " FAILED (errno " << errno << ")\n";
+            fs::remove(tmp, ec);
+            return SaveResult::Failed;
+        }
+        fs::rename(tmp, filepath, ec);
+        if (ec) {
+            std::cerr << "[Writer] save_if_changed: rename to " << filepath.string() << " FAILED (" << ec.message() << ")\n";
+            fs::remove(tmp, ec);
+            return SaveResult::Failed;
+        }
+        return SaveResult::Written;
+    }
+
+    uint64_t Writer::content_hash() const {
+        uint64_t h = 14695981039346656037ull;
+        for_each_chunk([&](std::string_view c) {
+            for (unsigned char ch : c) { h ^= ch; h *= 1099511628211ull; }
+        });
+        return h;
     }
 
     void Writer::clear() {
-        lines_.clear();
+        text_.clear();
+        lineStarts_.clear();
+        chunks_.clear();
+        sealedLines_ = 0;
+        ++chunkEpoch_;
+        pool_.clear();
+        poolIndex_.clear();
+        internStats_ = {};
         indentLevel_ = 0;
+        stream_.flushedLines = 0;
+        stream_.flushedBytes = 0;
+    }
+
+    void Writer::flush() {
+        if (!stream_.sink || text_.empty()) return;
+        WRITER_METRIC(MetricsScope timing(metrics_.io_ns, ioDepth_);)
+        stream_.sink(text_);
+        stream_.flushedLines += lineStarts_.size();
+        stream_.flushedBytes += text_.size();
+        text_.clear();          // keeps capacity, so steady state does not allocate
+        lineStarts_.clear();
+    }
+
+    void Writer::reserve(size_t bytes, size_t lineCount) {
+        text_.reserve(bytes);
+        lineStarts_.reserve(lineCount);
     }
 
     std::string Writer::str() const {
-        std::ostringstream oss;
-        for (const auto& l : lines_) oss << l << '\n';
-        return oss.str();
-    }
-
-    // internals
-    std::string Writer::replace_placeholders(const std::string& s, const Vars& vars, ReplaceStats& st) {
-        std::string out; out.reserve(s.size());
-        for (size_t i = 0; i < s.size(); ) {
-            if (i + 1 < s.size() && s[i] == '$' && s[i + 1] == '{') {
-                size_t end = s.find('}', i + 2);
-                if (end != std::string::npos) {
-                    std::string key = s.substr(i + 2, end - (i + 2));
-                    ++st.placeholders_found;
-                    auto it = vars.find(key);
-                    if (it != vars.end()) {
-                        out += it->second;
-                        ++st.replacements_done;
-                    }
+        std::string out;
+        out.reserve(byte_size());
+        for_each_chunk([&](std::string_view c) { out += c; });
+        return out;
+    }
+
+    std::string_view Writer::view() {
+        if (!chunks_.empty()) {
+            // Merge once; later calls are free until the next splice
+            std::pmr::string merged(resource());
+            merged.reserve(byte_size());
+            std::pmr::vector<size_t> starts(resource());
+            starts.reserve(sealedLines_ + lineStarts_.size());
+            auto take = [&](std::string_view text, const std::pmr::vector<size_t>& lineStarts) {
+                for (size_t s : lineStarts) starts.push_back(merged.size() + s);
+                merged += text;
+            };
+            for (const auto& c : chunks_) {
+                if (!c.interned) { take(c.text, c.lineStarts); continue; }
+                visit_lines(pool_, c.lineStarts, &c.lineLengths, [&](std::string_view line) {
+                    starts.push_back(merged.size());
+                    merged += line;
+                });
+            }
+            take(text_, lineStarts_);
+            text_ = std::move(merged);
+            lineStarts_ = std::move(starts);
+            chunks_.clear();
+            sealedLines_ = 0;
+            ++chunkEpoch_;
+            // Nothing refers to the pool any more; later blocks start a new one
+            pool_.clear();
+            poolIndex_.clear();
+        }
+        return text_;
+    }
+
+    size_t Writer::byte_size() const {
+        size_t n = text_.size();
+        for (const auto& c : chunks_) n += c.interned ? c.bytes : c.text.size();
+        return n;
+    }
+
+    // memoized sections
+    const SectionCache::Entry* SectionCache::find(std::string_view key, uint64_t inputHash, int indentLevel) {
+        auto it = entries_.find(key);
+        if (it == entries_.end() || it->second.inputHash != inputHash || it->second.indentLevel != indentLevel) {
+            ++stats_.misses;
+            return nullptr;
+        }
+        ++stats_.hits;
+        stats_.bytes_reused += it->second.text.size();
+        return &it->second;
+    }
+
+    const SectionCache::Entry& SectionCache::store(std::string_view key, uint64_t inputHash, int indentLevel, std::string_view text) {
+        auto it = entries_.find(key);
+        if (it == entries_.end()) it = entries_.emplace(std::string(key), Entry{}).first;
+        Entry& e = it->second;
+        e.inputHash = inputHash;
+        e.indentLevel = indentLevel;
+        e.text.assign(text);
+        e.lineStarts.clear();
+        for (size_t b = 0; b < text.size(); b = text.find('\n', b) + 1) e.lineStarts.push_back(b);
+        return e;
+    }
+
+    void Writer::append_section(const SectionCache::Entry& entry) {
+        grow(entry.text.size(), entry.lineStarts.size());
+        const size_t base = text_.size();
+        for (size_t start : entry.lineStarts) lineStarts_.push_back(base + start);
+        text_ += entry.text;
+        WRITER_METRIC(note_line(entry.text.size(), entry.lineStarts.size());)
+        if (text_.size() >= blockLimit_) block_full();
+    }
+
+    // fragments
+    Writer Writer::child() const {
+        Writer w(indentUnit_, resource());
+        w.indentLevel_ = indentLevel_;
+        w.set_interning(interning_);
+        return w;
+    }
+
+    void Writer::splice(Writer&& fragment) {
+        if (&fragment == this) return;
+        WRITER_METRIC(absorb_metrics(fragment.metrics_, true);)
+        if (streaming()) {
+            flush();
+            WRITER_METRIC(MetricsScope timing(metrics_.io_ns, ioDepth_);)
+            fragment.for_each_chunk([&](std::string_view c) {
+                stream_.sink(c);
+                stream_.flushedBytes += c.size();
+            });
+            stream_.flushedLines += fragment.size();
+        }
+        else {
+            seal();
+            // Allocator-extended moves: buffers are taken over when the fragment shares
+            // this Writer's resource (child()), and copied into it otherwise. When either
+            // side interns, the lines go through this Writer's pool (or out of the fragment's).
+            auto adopt = [&](std::pmr::string& text, std::pmr::vector<size_t>& lineStarts, LineLengths pooled) {
+                if (interning_ || pooled) {
+                    const std::string_view source = pooled ? std::string_view(fragment.pool_) : std::string_view(text);
+                    if (interning_) chunks_.push_back(interned_chunk(source, lineStarts, pooled));
                     else {
-                        // Keep visible in output for easier debugging
-                        out += "${"; out += key; out += "}";
-                        st.missing_placeholders.push_back(key);
+                        Chunk c{ std::pmr::string(resource()), std::pmr::vector<size_t>(resource()), sealedLines_ };
+                        visit_lines(source, lineStarts, pooled, [&](std::string_view line) {
+                            c.lineStarts.push_back(c.text.size());
+                            c.text += line;
+                        });
+                        chunks_.push_back(std::move(c));
                     }
-                    i = end + 1;
+                }
+                else {
+                    chunks_.push_back({ std::pmr::string(std::move(text), resource()),
+                        std::pmr::vector<size_t>(std::move(lineStarts), resource()), sealedLines_ });
+                }
+                sealedLines_ += chunks_.back().lineStarts.size();
+            };
+            for (auto& c : fragment.chunks_) adopt(c.text, c.lineStarts, c.interned ? &c.lineLengths : nullptr);
+            if (!fragment.text_.empty()) adopt(fragment.text_, fragment.lineStarts_, nullptr);
+        }
+        fragment.text_.clear();
+        fragment.lineStarts_.clear();
+        fragment.chunks_.clear();
+        fragment.sealedLines_ = 0;
+        ++fragment.chunkEpoch_;
+    }
+
+    // deferred regions
+    Writer::Anchor Writer::anchor() {
+        if (streaming()) {
+            std::cerr << "[Writer] anchor() is unavailable while streaming\n";
+            return {};
+        }
+        seal();
+        chunks_.push_back({ std::pmr::string(resource()), std::pmr::vector<size_t>(resource()), sealedLines_, ++nextSlot_ });
+        return { chunks_.size() - 1, indentLevel_, chunkEpoch_, nextSlot_ };
+    }
+
+    Writer Writer::child(const Anchor& at) const {
+        Writer w = child();
+        w.indentLevel_ = at.indentLevel;
+        return w;
+    }
+
+    bool Writer::fill(const Anchor& at, Writer&& fragment) {
+        if (&fragment == this) return false;
+        if (at.epoch != chunkEpoch_ || at.chunk >= chunks_.size() || chunks_[at.chunk].slot != at.slot) {
+            std::cerr << "[Writer] fill(): stale anchor (merged by view(), cleared or rolled back)\n";
+            return false;
+        }
+
+        WRITER_METRIC(absorb_metrics(fragment.metrics_, true);)
+        Chunk& slot = chunks_[at.chunk];
+        size_t added = 0;
+        auto take = [&](std::pmr::string& text, std::pmr::vector<size_t>& lineStarts, LineLengths pooled) {
+            added += lineStarts.size();
+            if (pooled) {
+                visit_lines(fragment.pool_, lineStarts, pooled, [&](std::string_view line) {
+                    slot.lineStarts.push_back(slot.text.size());
+                    slot.text += line;
+                });
+                return;
+            }
+            if (slot.text.empty()) {
+                // First fill: the fragment's buffers become the slot (moved when resources match)
+                slot.text = std::pmr::string(std::move(text), resource());
+                slot.lineStarts = std::pmr::vector<size_t>(std::move(lineStarts), resource());
+                return;
+            }
+            const size_t base = slot.text.size();
+            for (size_t s : lineStarts) slot.lineStarts.push_back(base + s);
+            slot.text += text;
+        };
+        for (auto& c : fragment.chunks_) take(c.text, c.lineStarts, c.interned ? &c.lineLengths : nullptr);
+        if (!fragment.text_.empty()) take(fragment.text_, fragment.lineStarts_, nullptr);
+
+        // Only the line numbering of later chunks moves
+        for (size_t i = at.chunk + 1; i < chunks_.size(); ++i) chunks_[i].firstLine += added;
+        sealedLines_ += added;
+
+        fragment.text_.clear();
+        fragment.lineStarts_.clear();
+        fragment.chunks_.clear();
+        fragment.sealedLines_ = 0;
+        ++fragment.chunkEpoch_;
+        return true;
+    }
+
+    // speculative emission
+    bool Writer::rollback(const Mark& at) {
+        if (at.epoch != chunkEpoch_ || at.chunks > chunks_.size() || at.flushedBytes != stream_.flushedBytes) {
+            std::cerr << "[Writer] rollback(): stale mark (merged by view(), cleared or flushed since)\n";
+            return false;
+        }
+        if (chunks_.size() > at.chunks) {
+            // Sealed since the mark (splice/anchor): the text of that time opens the first dropped chunk
+            Chunk& open = chunks_[at.chunks];
+            if (at.bytes > 0 && open.interned) {
+                // Compacted since: the lines of that time are read back out of the pool
+                text_.clear();
+                lineStarts_.clear();
+                open.lineStarts.resize(at.lines);
+                open.lineLengths.resize(at.lines);
+                visit_lines(pool_, open.lineStarts, &open.lineLengths, [&](std::string_view line) {
+                    lineStarts_.push_back(text_.size());
+                    text_ += line;
+                });
+            }
+            else if (at.bytes > 0) {
+                text_ = std::move(open.text);
+                lineStarts_ = std::move(open.lineStarts);
+            }
+            chunks_.erase(chunks_.begin() + ptrdiff_t(at.chunks), chunks_.end());
+            sealedLines_ = chunks_.empty() ? 0 : chunks_.back().firstLine + chunks_.back().lineStarts.size();
+        }
+        text_.resize(at.bytes);
+        lineStarts_.resize(at.lines);
+        indentLevel_ = at.indentLevel;
+        return true;
+    }
+
+    void Writer::seal() {
+        if (text_.empty()) return;
+        if (interning_) { intern_block(); return; }
+        chunks_.push_back({ std::move(text_), std::move(lineStarts_), sealedLines_ });
+        sealedLines_ += chunks_.back().lineStarts.size();
+        text_.clear();
+        lineStarts_.clear();
+    }
+
+    void Writer::grow(size_t bytes, size_t lineCount) {
+        // A streaming buffer is flushed and an interning one compacted every block; reserving
+        // past that would only hold memory (and undo streaming's bound on it)
+        if (blockLimit_ != SIZE_MAX) {
+            bytes = std::min(bytes, blockLimit_);
+            lineCount = std::min(lineCount, blockLimit_ / 8);
+        }
+        // Geometric, so per-call pre-sizing never degrades into a reallocation per line
+        if (text_.capacity() - text_.size() < bytes)
+            text_.reserve(std::max(text_.size() + bytes, text_.capacity() * 2));
+        if (lineStarts_.capacity() - lineStarts_.size() < lineCount)
+            lineStarts_.reserve(std::max(lineStarts_.size() + lineCount, lineStarts_.capacity() * 2));
+    }
+
+    void Writer::drop_failed_line(size_t start, std::string_view fmt, const char* error) {
+        std::cerr << "[Writer] linef(\"" << fmt << "\"): " << error << "\n";
+        text_.resize(start);
+        lineStarts_.pop_back();
+    }
+
+    std::string_view Writer::line_at(size_t i) const {
+        if (i < stream_.flushedLines || i >= size()) {
+            std::cerr << "[Writer] line_at(" << i << "): " << (i < stream_.flushedLines ? "already flushed" : "past the end") << "\n";
+            return {};
+        }
+        i -= stream_.flushedLines;
+        if (i >= sealedLines_) return line_in(text_, lineStarts_, i - sealedLines_);
+        auto it = std::upper_bound(chunks_.begin(), chunks_.end(), i,
+            [](size_t line, const Chunk& c) { return line < c.firstLine; });
+        --it;
+        if (it->interned) return line_in(pool_, it->lineStarts, i - it->firstLine, &it->lineLengths);
+        return line_in(it->text, it->lineStarts, i - it->firstLine);
+    }
+
+    std::string_view Writer::line_in(std::string_view text, const std::pmr::vector<size_t>& starts, size_t i, LineLengths lengths) {
+        size_t b = starts[i];
+        size_t e = (lengths ? b + (*lengths)[i] : i + 1 < starts.size() ? starts[i + 1] : text.size()) - 1;
+        return text.substr(b, e - b);
+    }
+
+    // line interning
+    void Writer::set_interning(bool on) {
+        if (on && streaming()) {
+            std::cerr << "[Writer] set_interning(): not available while streaming\n";
+            return;
+        }
+        interning_ = on;
+        blockLimit_ = on ? kDefaultBlockSize : SIZE_MAX;
+    }
+
+    void Writer::block_full() {
+        if (stream_.sink) flush();
+        else if (interning_) intern_block();
+        else blockLimit_ = SIZE_MAX;   // a copy or moved-from streaming Writer: no blocks any more
+    }
+
+    void Writer::intern_block() {
+        if (text_.empty()) return;
+        // Storage peaks right before a compaction: the full block next to everything interned so far
+        internStats_.peak_bytes = std::max(internStats_.peak_bytes, storage_bytes());
+        Chunk c = interned_chunk(text_, lineStarts_, nullptr);
+        sealedLines_ += c.lineStarts.size();
+        chunks_.push_back(std::move(c));
+        text_.clear();          // keeps capacity for the next block
+        lineStarts_.clear();
+    }
+
+    Writer::Chunk Writer::interned_chunk(std::string_view text, const std::pmr::vector<size_t>& starts, LineLengths lengths) {
+        Chunk c{ std::pmr::string(resource()), std::pmr::vector<size_t>(resource()), sealedLines_ };
+        c.interned = true;
+        c.lineLengths = std::pmr::vector<size_t>(resource());
+        c.lineStarts.reserve(starts.size());
+        c.lineLengths.reserve(starts.size());
+        visit_lines(text, starts, lengths, [&](std::string_view line) {
+            c.bytes += line.size();
+            c.lineStarts.push_back(intern(line));
+            c.lineLengths.push_back(line.size());
+        });
+        return c;
+    }
+
+    size_t Writer::intern(std::string_view line) {
+        ++internStats_.lines;
+        internStats_.logical_bytes += line.size();
+        auto [it, added] = poolIndex_.try_emplace(std::hash<std::string_view>{}(line), pool_.size(), line.size());
+        const auto [at, length] = it->second;
+        if (!added && length == line.size() && std::string_view(pool_).substr(at, length) == line) return at;
+        // New text, or a hash collision (the first line keeps the index entry; this one is stored unindexed)
+        const size_t offset = pool_.size();
+        pool_ += line;
+        ++internStats_.unique_lines;
+        internStats_.pool_bytes += line.size();
+        return offset;
+    }
+
+    size_t Writer::storage_bytes() const {
+        size_t n = text_.capacity() + lineStarts_.capacity() * sizeof(size_t) + chunks_.capacity() * sizeof(Chunk);
+        for (const auto& c : chunks_) n += c.text.capacity() + (c.lineStarts.capacity() + c.lineLengths.capacity()) * sizeof(size_t);
+        // Node-based index: a node per entry (value plus next pointer and cached hash) and a bucket array
+        n += pool_.capacity() + poolIndex_.size() * (sizeof(std::pair<const size_t, std::pair<size_t, size_t>>) + 2 * sizeof(void*))
+            + poolIndex_.bucket_count() * sizeof(void*);
+        return n;
+    }
+
+    // instrumentation
+    Writer::Metrics Writer::metrics() const {
+#if WRITER_INSTRUMENTATION
+        return metrics_;
+#else
+        return {};
+#endif
+    }
+
+    void Writer::reset_metrics() {
+        WRITER_METRIC(metrics_ = {};)
+    }
+
+    std::string Writer::Metrics::to_json() const {
+#if WRITER_INSTRUMENTATION
+        const nlohmann::json j = {
+            { "lines", lines },
+            { "bytes", bytes },
+            { "template_calls", template_calls },
+            { "template_scans", template_scans },
+            { "placeholders", placeholders },
+            { "replacements", replacements },
+            { "misses", misses },
+            { "allocations", allocations },
+            { "substitution_ms", double(substitution_ns) / 1e6 },
+            { "io_ms", double(io_ns) / 1e6 },
+        };
+        return j.dump(2);
+#else
+        return "{ \"enabled\": false }";
+#endif
+    }
+
+    Writer::InternStats Writer::intern_stats() const {
+        InternStats st = internStats_;
+        st.peak_bytes = std::max(st.peak_bytes, storage_bytes());
+        return st;
+    }
+
+    // template scanning
+    const char* detail::find_template_special_scalar(const char* p, const char* end) {
+        for (; p != end; ++p) if (*p == '\n' || *p == '$') return p;
+        return end;
+    }
+
+    const char* detail::find_template_special(const char* p, const char* end) {
+#ifdef WRITER_SCAN_AVX2
+        const __m256i nl32 = _mm256_set1_epi8('\n');
+        const __m256i dollar32 = _mm256_set1_epi8('$');
+        for (; end - p >= 32; p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            uint32_t mask = uint32_t(_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, nl32), _mm256_cmpeq_epi8(v, dollar32))));
+            if (mask) return p + std::countr_zero(mask);
+        }
+#endif
+#ifdef WRITER_SCAN_SSE2
+        const __m128i nl16 = _mm_set1_epi8('\n');
+        const __m128i dollar16 = _mm_set1_epi8('$');
+        for (; end - p >= 16; p += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            uint32_t mask = uint32_t(_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(v, nl16), _mm_cmpeq_epi8(v, dollar16))));
+            if (mask) return p + std::countr_zero(mask);
+        }
+#endif
+        return find_template_special_scalar(p, end);
+    }
+
+    // compiled templates
+    Writer::CompiledTemplate::CompiledTemplate(std::string source, Mode mode)
+        : source_(std::move(source)), mode_(mode)
+    {
+        auto key_index = [&](std::string_view key) {
+            for (size_t k = 0; k < keys_.size(); ++k) if (keys_[k] == key) return uint32_t(k);
+            keys_.emplace_back(key);
+            return uint32_t(keys_.size() - 1);
+        };
+
+        const char* const base = source_.data();
+        const char* const end = base + source_.size();
+        const bool multiLine = mode_ == Mode::MultiLine;
+
+        size_t lineOp = 0;      // the current line's BeginLine
+        const char* lineBegin = base;
+        const char* lit = base;
+        auto begin_line_op = [&] {
+            lineOp = ops_.size();
+            ops_.push_back({ Op::BeginLine, 0, 0 });
+        };
+        auto flush_literal = [&](const char* upTo) {
+            if (upTo > lit) {
+                ops_.push_back({ Op::Literal, uint32_t(lit - base), uint32_t(upTo - lit) });
+                literal_bytes_ += size_t(upTo - lit);
+            }
+        };
+        // A line holding one block tag and whitespace only is not output at all
+        auto standalone = [&] {
+            size_t tags = 0;
+            for (size_t i = lineOp + 1; i < ops_.size(); ++i) {
+                const Op& op = ops_[i];
+                if (op.kind == Op::Literal) {
+                    for (uint32_t c = 0; c < op.length; ++c)
+                        if (base[op.offset + c] != ' ' && base[op.offset + c] != '\t') return false;
+                }
+                else if (op.kind == Op::Placeholder || ++tags > 1) return false;
+            }
+            return tags == 1;
+        };
+        auto finish_line = [&](const char* lineEnd) {
+            flush_literal(lineEnd);
+            if (multiLine && standalone()) {
+                Op tag{};
+                for (size_t i = lineOp + 1; i < ops_.size(); ++i) {
+                    if (ops_[i].kind == Op::Literal) literal_bytes_ -= ops_[i].length;
+                    else tag = ops_[i];
+                }
+                ops_.resize(lineOp);
+                ops_.push_back(tag);
+            }
+            else {
+                ops_.push_back({ Op::EndLine, 0, 0 });
+                ++line_count_;
+            }
+            begin_line_op();
+        };
+        auto tag = [&](const char* p, const char* close) {
+            const std::string_view key(p + 2, size_t(close - (p + 2)));
+            const uint32_t span = uint32_t(close + 1 - p);
+            if (key == "/each") return Op{ Op::EndEach, uint32_t(p - base), span };
+            if (key == "/if") return Op{ Op::EndIf, uint32_t(p - base), span };
+            if (key.starts_with("#each ")) return Op{ Op::Each, key_index(key.substr(6)), 0 };
+            if (key.starts_with("#if !")) return Op{ Op::IfNot, key_index(key.substr(5)), 0 };
+            if (key.starts_with("#if ")) return Op{ Op::If, key_index(key.substr(4)), 0 };
+            const uint32_t k = key_index(key);
+            if (key == "@index") index_key_ = k;
+            return Op{ Op::Placeholder, k, 0 };
+        };
+
+        begin_line_op();
+
+        // Same grammar as before: "${" up to the next '}' on the same line is a
+        // placeholder, an unterminated "${" is literal text. CR directly before LF
+        // is dropped, a lone CR is content. Only '\n' and '$' need attention, so
+        // the vectorized scan skips everything else in 16/32-byte strides.
+        for (const char* p = detail::find_template_special(base, end); p != end; p = detail::find_template_special(p, end)) {
+            if (*p == '\n') {
+                if (multiLine) {
+                    finish_line((p > lineBegin && p[-1] == '\r') ? p - 1 : p);
+                    lineBegin = lit = p + 1;
+                }
+                ++p;
+                continue;
+            }
+            if (p + 1 < end && p[1] == '{') {
+                const char* close = p + 2;
+                while (close < end && *close != '}' && !(multiLine && *close == '\n')) ++close;
+                if (close < end && *close == '}') {
+                    flush_literal(p);
+                    ops_.push_back(tag(p, close));
+                    p = lit = close + 1;
                     continue;
                 }
             }
-            out += s[i++];
+            ++p;
         }
-        return out;
+
+        // A single-line template is always one line; a trailing unterminated
+        // line of a multi-line template is emitted only when non-empty.
+        if (!multiLine || lineBegin < end) finish_line(end);
+        ops_.pop_back();   // the BeginLine opened after the last line
+
+        // Pair block tags; a closer without its opener is dropped, an opener left
+        // open is closed at the end of the template. Dropping erases the op: a
+        // standalone closer has no BeginLine/EndLine around it, so anything left in
+        // its place would put a line-less op into the stream. Only ops not paired
+        // yet move, so the indices recorded so far stay valid.
+        std::vector<uint32_t> open;
+        for (uint32_t i = 0; i < ops_.size(); ) {
+            Op& op = ops_[i];
+            if (op.kind == Op::Each || op.kind == Op::If || op.kind == Op::IfNot) {
+                open.push_back(i);
+                has_blocks_ = true;
+                if (op.kind == Op::Each) {
+                    const auto eaches = std::count_if(open.begin(), open.end(), [&](uint32_t o) { return ops_[o].kind == Op::Each; });
+                    each_depth_ = std::max(each_depth_, uint32_t(eaches));
+                }
+            }
+            else if (op.kind == Op::EndEach || op.kind == Op::EndIf) {
+                const bool matches = !open.empty() && ((ops_[open.back()].kind == Op::Each) == (op.kind == Op::EndEach));
+                if (!matches) {
+                    std::cerr << "[Writer] template: unmatched " << std::string_view(base + op.offset, op.length) << " ignored\n";
+                    ops_.erase(ops_.begin() + i);
+                    continue;
+                }
+                op.length = open.back();
+                ops_[open.back()].length = i;
+                open.pop_back();
+            }
+            ++i;
+        }
+        while (!open.empty()) {
+            Op& opener = ops_[open.back()];
+            std::cerr << "[Writer] template: unterminated ${" << (opener.kind == Op::Each ? "#each " : "#if ") << keys_[opener.offset] << "} closed at the end\n";
+            opener.length = uint32_t(ops_.size());
+            ops_.push_back({ opener.kind == Op::Each ? Op::EndEach : Op::EndIf, 0, open.back() });
+            open.pop_back();
+        }
+    }
+
+    const Writer::CompiledTemplate& Writer::compiled(std::string_view tmpl, CompiledTemplate::Mode mode) const {
+        // Keyed by template text; per thread so concurrent Writers never contend.
+        // Bounded so templates built at runtime cannot grow it without limit.
+        constexpr size_t kMaxEntries = 1024;
+        using Cache = std::unordered_map<std::string_view, std::unique_ptr<CompiledTemplate>>;
+        static thread_local Cache caches[2];
+
+        Cache& cache = caches[mode == CompiledTemplate::Mode::MultiLine ? 1 : 0];
+        auto it = cache.find(tmpl);
+        if (it != cache.end()) return *it->second;
+
+        if (cache.size() >= kMaxEntries) cache.clear();
+        WRITER_METRIC(++metrics_.template_scans;)
+        auto t = std::make_unique<CompiledTemplate>(std::string(tmpl), mode);
+        std::string_view key = t->source();
+        return *cache.emplace(key, std::move(t)).first->second;
     }
 
-    void Writer::collect_used_placeholders(const std::string& s, std::unordered_set<std::string>& used) {
-        for (size_t i = 0; i < s.size(); ) {
-            if (i + 1 < s.size() && s[i] == '$' && s[i + 1] == '{') {
-                size_t end = s.find('}', i + 2);
-                if (end != std::string::npos) {
-                    used.insert(s.substr(i + 2, end - (i + 2)));
-                    i = end + 1; continue;
+    void Writer::instantiate(const CompiledTemplate& t, const VarsView& vars, std::string_view prefix, ReplaceStats& st) {
+        WRITER_METRIC(MetricsScope timing(metrics_.substitution_ns, substitutionDepth_);)
+        // Resolve every distinct key once, not once per occurrence;
+        // numbers are rendered here, straight from the caller's values
+        constexpr size_t kInline = 16;
+        ResolvedKey inlineValues[kInline];
+        std::vector<ResolvedKey> heapValues;
+        ResolvedKey* values = inlineValues;
+        if (t.keys_.size() > kInline) { heapValues.resize(t.keys_.size()); values = heapValues.data(); }
+        for (size_t k = 0; k < t.keys_.size(); ++k) {
+            Value v;
+            values[k].found = vars.find(t.keys_[k], v);
+            if (values[k].found) values[k].text = v.format(values[k].buf);
+        }
+
+        const size_t perLine = indent_prefix().size() + prefix.size() + 1;
+        grow(t.literal_bytes_ + t.line_count_ * perLine, t.line_count_);
+
+        if (t.has_blocks_) instantiate_blocks(t, vars, prefix, values, st);
+        else emit_lines(t, prefix, values, st);
+        WRITER_METRIC(note_template(st);)
+    }
+
+    void Writer::emit_lines(const CompiledTemplate& t, std::string_view prefix, const ResolvedKey* values, ReplaceStats& st) {
+        using Op = CompiledTemplate::Op;
+
+        // Without blocks the program is BeginLine, literals and placeholders, EndLine, per line
+        const Op* op = t.ops_.data();
+        const Op* const end = op + t.ops_.size();
+        while (op != end) {
+            begin_line();
+            text_ += prefix;
+            for (++op; op->kind != Op::EndLine; ++op) {
+                if (op->kind == Op::Literal) { text_.append(t.source_, op->offset, op->length); continue; }
+                const ResolvedKey& v = values[op->offset];
+                if (!v.found) { put_placeholder(t, op->offset, v, st); continue; }
+                text_ += v.text;
+                ++st.placeholders_found;
+                ++st.replacements_done;
+            }
+            end_line();
+            ++op;
+        }
+    }
+
+    void Writer::put_placeholder(const CompiledTemplate& t, uint32_t k, const ResolvedKey& value, ReplaceStats& st) {
+        ++st.placeholders_found;
+        if (value.found) {
+            text_ += value.text;
+            ++st.replacements_done;
+        }
+        else {
+            // Keep visible in output for easier debugging
+            const std::string& key = t.keys_[k];
+            text_ += "${"; text_ += key; text_ += "}";
+            st.missing_placeholders.emplace_back(key);
+        }
+    }
+
+    void Writer::instantiate_blocks(const CompiledTemplate& t, const VarsView& vars, std::string_view prefix,
+        const ResolvedKey* values, ReplaceStats& st, const Table* rows, size_t row)
+    {
+        using Op = CompiledTemplate::Op;
+        const size_t keyCount = t.keys_.size();
+
+        // ${#each} rows being repeated, innermost last. Each scope has a slot per key: the
+        // key's column in that table and the cell rendered for the current row. current
+        // holds every key's text as a placeholder sees it (the innermost scope that has the
+        // column, else the caller's value); it is updated when a row starts or a scope ends,
+        // so a placeholder is one lookup, as in emit_lines. All of it lives on a small stack
+        // arena; only deep nesting of templates with many keys reaches the heap. A slot's
+        // text may point into its own buf, so slots are sized for the deepest nesting up
+        // front and never reallocate while in use.
+        struct Scope { const Table* table; size_t row; };
+        struct Slot { int column; std::string_view text; char buf[Value::kFormatBuffer]; };
+        struct Current { std::string_view text; bool found; };
+        alignas(std::max_align_t) char scratch[2048];
+        std::pmr::monotonic_buffer_resource arena(scratch, sizeof(scratch));
+        std::pmr::vector<Scope> scopes(&arena);
+        std::pmr::vector<Slot> slots(&arena);   // keyCount per scope
+        std::pmr::vector<Current> current(&arena);
+        const size_t maxScopes = size_t(t.each_depth_) + (rows ? 1 : 0);
+        scopes.reserve(maxScopes);
+        slots.reserve(maxScopes * keyCount);
+        current.reserve(keyCount);
+        for (size_t k = 0; k < keyCount; ++k) current.push_back({ values[k].text, values[k].found });
+
+        auto in_scope = [&](uint32_t k, Value& out) {
+            for (size_t s = scopes.size(); s-- > 0; ) {
+                if (k == t.index_key_) { out = Value(scopes[s].row); return true; }
+                const int c = slots[s * keyCount + k].column;
+                if (c >= 0) { out = scopes[s].table->cell(scopes[s].row, size_t(c)); return true; }
+            }
+            return false;
+        };
+        auto resolve = [&](uint32_t k, Value& out) {
+            return in_scope(k, out) || (values[k].found && vars.find(t.keys_[k], out));
+        };
+        // Renders the innermost scope's cells for its current row
+        auto enter_row = [&] {
+            const Scope& scope = scopes.back();
+            Slot* slot = slots.data() + (scopes.size() - 1) * keyCount;
+            for (size_t k = 0; k < keyCount; ++k, ++slot) {
+                if (slot->column < 0) continue;
+                const Value v = k == t.index_key_ ? Value(scope.row) : scope.table->cell(scope.row, size_t(slot->column));
+                slot->text = v.format(slot->buf);
+                current[k] = { slot->text, true };
+            }
+        };
+        auto push_scope = [&](const Table* table, size_t first) {
+            scopes.push_back({ table, first });
+            for (size_t k = 0; k < keyCount; ++k) {
+                // @index is a slot of its own; a column of that name would be unreachable
+                const int column = k == t.index_key_ ? int(table->columns()) : table->column(t.keys_[k]);
+                slots.push_back({ column, {}, {} });
+            }
+            enter_row();
+        };
+        // The keys of the innermost scope fall back to the enclosing scopes or the caller's values
+        auto pop_scope = [&] {
+            const size_t inner = scopes.size() - 1;
+            for (size_t k = 0; k < keyCount; ++k) {
+                if (slots[inner * keyCount + k].column < 0) continue;
+                current[k] = { values[k].text, values[k].found };
+                for (size_t s = inner; s-- > 0; ) {
+                    const Slot& outer = slots[s * keyCount + k];
+                    if (outer.column >= 0) { current[k] = { outer.text, true }; break; }
                 }
             }
+            scopes.pop_back();
+            slots.resize(slots.size() - keyCount);
+        };
+        if (rows) push_scope(rows, row);   // lines_batch: the row is the outermost scope
+
+        const Op* const ops = t.ops_.data();
+        const size_t opCount = t.ops_.size();
+        for (size_t i = 0; i < opCount; ) {
+            const Op& op = ops[i];
+            switch (op.kind) {
+            case Op::BeginLine:
+                begin_line();
+                text_ += prefix;
+                break;
+            case Op::Literal:
+                text_.append(t.source_, op.offset, op.length);
+                break;
+            case Op::EndLine:
+                end_line();
+                break;
+            case Op::Placeholder: {
+                const Current& v = current[op.offset];
+                if (!v.found) { put_placeholder(t, op.offset, values[op.offset], st); break; }
+                text_ += v.text;
+                ++st.placeholders_found;
+                ++st.replacements_done;
+                break;
+            }
+            case Op::Each: {
+                Value v;
+                const Table* each = resolve(op.offset, v) ? v.table() : nullptr;
+                if (!each) st.missing_placeholders.emplace_back(t.keys_[op.offset]);
+                if (!each || each->rows() == 0) { i = op.length + 1; continue; }
+                push_scope(each, 0);
+                break;
+            }
+            case Op::EndEach: {
+                Scope& scope = scopes.back();
+                if (++scope.row < scope.table->rows()) { enter_row(); i = op.length + 1; continue; }
+                pop_scope();
+                break;
+            }
+            case Op::If:
+            case Op::IfNot: {
+                Value v;
+                const bool truthy = resolve(op.offset, v) && v.truthy();
+                if (truthy != (op.kind == Op::If)) { i = op.length + 1; continue; }
+                break;
+            }
+            case Op::EndIf:
+                break;
+            }
             ++i;
         }
     }
 
-    void Writer::report_replace_issue(const char* fn, const std::string& /*src*/,
+    void Writer::instantiate_rows(const CompiledTemplate& t, const Table& rows, const VarsView& shared, ReplaceStats& st) {
+        WRITER_METRIC(MetricsScope timing(metrics_.substitution_ns, substitutionDepth_);)
+        // Per key: its column, or its shared value resolved once for the whole batch
+        constexpr size_t kInline = 16;
+        ResolvedKey inlineValues[kInline];
+        int inlineColumns[kInline];
+        std::vector<ResolvedKey> heapValues;
+        std::vector<int> heapColumns;
+        ResolvedKey* values = inlineValues;
+        int* columns = inlineColumns;
+        const size_t keyCount = t.keys_.size();
+        if (keyCount > kInline) {
+            heapValues.resize(keyCount); values = heapValues.data();
+            heapColumns.resize(keyCount); columns = heapColumns.data();
+        }
+        for (size_t k = 0; k < keyCount; ++k) {
+            columns[k] = k == t.index_key_ ? int(rows.columns()) : rows.column(t.keys_[k]);
+            Value v;
+            values[k].found = columns[k] < 0 && shared.find(t.keys_[k], v);
+            if (values[k].found) values[k].text = v.format(values[k].buf);
+        }
+
+        const size_t count = rows.rows();
+        if (t.has_blocks_) {
+            for (size_t r = 0; r < count; ++r) instantiate_blocks(t, shared, "", values, st, &rows, r);
+            WRITER_METRIC(note_template(st);)
+            return;
+        }
+
+        const size_t perLine = indent_prefix().size() + 1;
+        grow(t.literal_bytes_ + t.line_count_ * perLine, t.line_count_);
+        for (size_t r = 0; r < count; ++r) {
+            for (size_t k = 0; k < keyCount; ++k) {
+                if (columns[k] < 0) continue;
+                const Value v = k == t.index_key_ ? Value(r) : rows.cell(r, size_t(columns[k]));
+                values[k].text = v.format(values[k].buf);
+                values[k].found = true;
+            }
+            const size_t before = text_.size();
+            emit_lines(t, "", values, st);
+            // The first row's size, plus an eighth, stands in for every other row
+            if (r == 0 && count > 1) {
+                const size_t rowBytes = text_.size() - before;
+                grow((count - 1) * (rowBytes + rowBytes / 8), (count - 1) * t.line_count_);
+            }
+        }
+        WRITER_METRIC(note_template(st);)
+    }
+
+    void Writer::collect_unused_keys(const CompiledTemplate& t, const VarsView& vars, ReplaceStats& st) {
+        vars.for_each_key([&](std::string_view key) {
+            if (std::find(t.keys_.begin(), t.keys_.end(), key) == t.keys_.end())
+                st.unused_keys.emplace_back(key);
+        });
+    }
+
+    std::string_view Value::format_other(char* buf) const {
+        char* const end = buf + kFormatBuffer;
+        std::to_chars_result r{ buf, std::errc() };
+        switch (kind_) {
+        case Kind::Text:   return text_;
+        case Kind::Table:  return {};
+        case Kind::Int:    r = std::to_chars(buf, end, int_); break;
+        case Kind::UInt:   r = std::to_chars(buf, end, uint_); break;
+        case Kind::Float:
+        case Kind::Double: {
+            // Neither format nor precision: the plain overload, so 1234567.f is "1234567" and
+            // 1e-4 is "1e-04" as with std::format("{}"), not general's "1.23457e+06" style
+            auto render = [&](bool shortest) {
+                if (shortest || (!floatFormat_.format && floatFormat_.precision < 0))
+                    return kind_ == Kind::Float ? std::to_chars(buf, end, float_) : std::to_chars(buf, end, double_);
+                const auto fmt = floatFormat_.format.value_or(std::chars_format::general);
+                if (kind_ == Kind::Float)
+                    return shortest || floatFormat_.precision < 0 ? std::to_chars(buf, end, float_, fmt)
+                                                                  : std::to_chars(buf, end, float_, fmt, floatFormat_.precision);
+                return shortest || floatFormat_.precision < 0 ? std::to_chars(buf, end, double_, fmt)
+                                                              : std::to_chars(buf, end, double_, fmt, floatFormat_.precision);
+            };
+            r = render(false);
+            if (r.ec != std::errc()) r = render(true);
+            if (floatFormat_.decimal_point && r.ptr + 2 <= end
+                && std::find_if(buf, r.ptr, [](char c) { return c == '.' || c == 'e' || c == 'n' || c == 'i'; }) == r.ptr) {
+                *r.ptr++ = '.';
+                *r.ptr++ = '0';
+            }
+            break;
+        }
+        }
+        return std::string_view(buf, size_t(r.ptr - buf));
+    }
+
+    bool Value::truthy() const {
+        switch (kind_) {
+        case Kind::Text:   return !text_.empty();
+        case Kind::Int:    return int_ != 0;
+        case Kind::UInt:   return uint_ != 0;
+        case Kind::Float:  return float_ != 0.0f;
+        case Kind::Double: return double_ != 0.0;
+        case Kind::Table:  return table_->rows() > 0;
+        }
+        return false;
+    }
+
+    // table
+    Table::Table(std::initializer_list<std::string_view> columns, std::pmr::memory_resource* resource)
+        : columns_(resource), cells_(resource), text_(resource) {
+        columns_.reserve(columns.size());
+        for (std::string_view c : columns) columns_.emplace_back(c);
+    }
+
+    void Table::add_row(std::initializer_list<Value> cells) {
+        if (cells.size() != columns_.size())
+            std::cerr << "[Writer] Table::add_row: " << cells.size() << " cells for " << columns_.size() << " columns\n";
+        auto it = cells.begin();
+        for (size_t c = 0; c < columns_.size(); ++c) {
+            Cell cell;
+            if (it != cells.end()) {
+                if (it->is_text()) {
+                    char unused[Value::kFormatBuffer];
+                    const std::string_view text = it->format(unused);
+                    cell.offset = uint32_t(text_.size());
+                    cell.length = uint32_t(text.size());
+                    cell.pooled = true;
+                    text_ += text;
+                }
+                else {
+                    cell.value = *it;
+                }
+                ++it;
+            }
+            cells_.push_back(cell);
+        }
+    }
+
+    void Table::reserve(size_t rowCount) { cells_.reserve(rowCount * columns_.size()); }
+
+    void Table::clear() {
+        cells_.clear();
+        text_.clear();
+    }
+
+    int Table::column(std::string_view name) const {
+        for (size_t c = 0; c < columns_.size(); ++c) if (columns_[c] == name) return int(c);
+        return -1;
+    }
+
+    Value Table::cell(size_t row, size_t column) const {
+        const Cell& c = cells_[row * columns_.size() + column];
+        if (c.pooled) return std::string_view(text_).substr(c.offset, c.length);
+        return c.value;
+    }
+
+    void Writer::report_replace_issue(const char* fn, std::string_view /*src*/,
         const ReplaceStats& st, bool require_any)
     {
         std::cerr << "[Writer] " << fn << " replacement check FAILED\n";
@@ -228,15 +1293,16 @@ namespace Writer_ {
         }
     }
 
-    void Writer::dedupe_sort(std::vector<std::string>& v) {
+    void Writer::dedupe_sort(std::pmr::vector<std::pmr::string>& v) {
         std::sort(v.begin(), v.end());
         v.erase(std::unique(v.begin(), v.end()), v.end());
     }
 
-    std::string Writer::indent_prefix() const {
-        std::string p; p.reserve(indentLevel_ * indentUnit_.size());
-        for (int i = 0; i < indentLevel_; ++i) p += indentUnit_;
-        return p;
+    void Writer::grow_indent_cache() {
+        // A few levels of headroom so deepening one level at a time rarely regrows
+        const size_t levels = size_t(indentLevel_) + 4;
+        indentCache_.reserve(levels * indentUnit_.size());
+        while (indentCache_.size() < levels * indentUnit_.size()) indentCache_ += indentUnit_;
     }
 
 } // namespace Writer_
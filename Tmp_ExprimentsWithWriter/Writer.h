@@ -5,20 +5,371 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <filesystem>
+#include <memory>
+#include <memory_resource>
+#include <cstdint>
 #include <ostream>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <initializer_list>
+#include <array>
+#include <charconv>
+#include <type_traits>
+#include <iterator>
+#include <optional>
 #include <format>     // C++20
 
+// Writer instrumentation (Writer::Metrics): define WRITER_INSTRUMENTATION=1 to compile it in.
+// Left at 0 the counters, timers and their hooks do not exist, so they cost nothing.
+#ifndef WRITER_INSTRUMENTATION
+#define WRITER_INSTRUMENTATION 0
+#endif
+
+#if WRITER_INSTRUMENTATION
+#include <chrono>
+#define WRITER_METRIC(...) __VA_ARGS__
+#else
+#define WRITER_METRIC(...)
+#endif
+
 namespace Writer_ {
 
+    // ---- Placeholder values ----
+    // How floating-point values are rendered. The default is std::to_chars' shortest
+    // representation that reads back to the same value, the text std::format("{}") and
+    // linef give; a format or precision selects that std::to_chars overload instead.
+    // decimal_point turns "1" into "1.0", which GLSL needs for float literals.
+    struct FloatFormat {
+        std::optional<std::chars_format> format;   // none: shortest, fixed or scientific
+        int precision = -1;         // < 0: shortest round-trip
+        bool decimal_point = false;
+    };
+
+    class Table;
+
+    // One placeholder value: text (viewed, not copied), an integer, a float/double or
+    // a Table for ${#each}. Numbers are rendered with std::to_chars during substitution,
+    // so callers pass them as they are instead of building a std::to_string temporary per key.
+    class Value {
+    public:
+        static constexpr size_t kFormatBuffer = 64;  // enough for any shortest float/double
+
+        Value() : kind_(Kind::Text), text_() {}
+        Value(std::string_view s) : kind_(Kind::Text), text_(s) {}
+        Value(const char* s) : kind_(Kind::Text), text_(s) {}
+        template <class Alloc>
+        Value(const std::basic_string<char, std::char_traits<char>, Alloc>& s) : kind_(Kind::Text), text_(s) {}
+
+        template <class I, std::enable_if_t<std::is_integral_v<I> && !std::is_same_v<I, bool> && !std::is_same_v<I, char>, int> = 0>
+        Value(I v) {
+            if constexpr (std::is_signed_v<I>) { kind_ = Kind::Int; int_ = v; }
+            else { kind_ = Kind::UInt; uint_ = v; }
+        }
+        Value(float v, FloatFormat f = {}) : kind_(Kind::Float), float_(v), floatFormat_(f) {}
+        Value(double v, FloatFormat f = {}) : kind_(Kind::Double), double_(v), floatFormat_(f) {}
+        Value(const Table& rows) : kind_(Kind::Table), table_(&rows) {}   // viewed; must outlive the call
+
+        bool is_text() const { return kind_ == Kind::Text; }
+        const Table* table() const { return kind_ == Kind::Table ? table_ : nullptr; }
+
+        // ${#if}: non-empty text, a non-zero number or a table with rows
+        bool truthy() const;
+
+        // Text is returned as is; numbers are rendered into buf (kFormatBuffer bytes).
+        // A fixed-precision value too long for buf falls back to the shortest form.
+        // A table renders as nothing.
+        std::string_view format(char* buf) const { return kind_ == Kind::Text ? text_ : format_other(buf); }
+
+    private:
+        std::string_view format_other(char* buf) const;
+
+        enum class Kind : uint8_t { Text, Int, UInt, Float, Double, Table };
+        Kind kind_ = Kind::Text;
+        union {
+            std::string_view text_;
+            long long int_;
+            unsigned long long uint_;
+            float float_;
+            double double_;
+            const Table* table_;
+        };
+        FloatFormat floatFormat_;
+    };
+
+    // Rows for ${#each KEY}...${/each}: named columns, one Value per cell. Text cells
+    // are copied in, so rows may be built from temporaries; numbers stay typed and
+    // a nested Table is viewed (it must outlive the Table). Inside the block a
+    // placeholder looks in the current row first, then in enclosing rows, then in the
+    // call's vars; ${@index} is the row number.
+    class Table {
+    public:
+        explicit Table(std::initializer_list<std::string_view> columns,
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+        void add_row(std::initializer_list<Value> cells);   // in column order
+        void reserve(size_t rowCount);
+        void clear();                                       // drops rows, keeps columns
+
+        size_t rows() const { return columns_.empty() ? 0 : cells_.size() / columns_.size(); }
+        size_t columns() const { return columns_.size(); }
+        int column(std::string_view name) const;            // -1 when absent
+        std::string_view column_name(size_t column) const { return columns_[column]; }
+        Value cell(size_t row, size_t column) const;
+
+    private:
+        struct Cell {
+            Value value;
+            uint32_t offset = 0;    // text cells: position in text_, which may reallocate
+            uint32_t length = 0;
+            bool pooled = false;
+        };
+        std::pmr::vector<std::pmr::string> columns_;
+        std::pmr::vector<Cell> cells_;
+        std::pmr::string text_;
+    };
+
+    // ---- Compile-time templates ----
+    // Template<"float ${NAME} = 0.0f;"> is parsed by the compiler (same grammar as
+    // the runtime templates). Writer::line/comment check it against the arg<"NAME">(v)
+    // list with static_assert: a placeholder without an arg, an arg the template does
+    // not use, or a duplicated arg is a compile error. Emission is unrolled into
+    // straight-line appends after one exact-size reservation.
+
+    template <size_t N>
+    struct FixedString {
+        char chars[N] {};
+        consteval FixedString(const char (&s)[N]) { for (size_t i = 0; i < N; ++i) chars[i] = s[i]; }
+        constexpr std::string_view view() const { return { chars, N - 1 }; }
+    };
+
+    namespace detail {
+        struct StaticOp {
+            enum Kind : uint8_t { BeginLine, Literal, Placeholder, EndLine };
+            Kind kind = BeginLine;
+            size_t offset = 0;   // literal text or placeholder key, within the source
+            size_t length = 0;
+        };
+
+        // Returns the op count; writes the ops when out is non-null
+        constexpr size_t parse_static(std::string_view s, bool multiLine, StaticOp* out) {
+            size_t n = 0;
+            auto put = [&](StaticOp::Kind k, size_t offset, size_t length) {
+                if (out) out[n] = { k, offset, length };
+                ++n;
+            };
+            auto line = [&](size_t b, size_t e) {
+                put(StaticOp::BeginLine, 0, 0);
+                size_t lit = b;
+                for (size_t i = b; i + 1 < e; ) {
+                    if (s[i] == '$' && s[i + 1] == '{') {
+                        size_t close = s.find('}', i + 2);
+                        if (close != std::string_view::npos && close < e) {
+                            if (i > lit) put(StaticOp::Literal, lit, i - lit);
+                            put(StaticOp::Placeholder, i + 2, close - (i + 2));
+                            i = lit = close + 1;
+                            continue;
+                        }
+                    }
+                    ++i;
+                }
+                if (e > lit) put(StaticOp::Literal, lit, e - lit);
+                put(StaticOp::EndLine, 0, 0);
+            };
+
+            if (!multiLine) { line(0, s.size()); return n; }
+            size_t b = 0;
+            for (size_t i = 0; i < s.size(); ++i) {
+                if (s[i] != '\n') continue;
+                line(b, (i > b && s[i - 1] == '\r') ? i - 1 : i);
+                b = i + 1;
+            }
+            if (b < s.size()) line(b, s.size());
+            return n;
+        }
+
+        // Next '\n' or '$' in [p, end), or end: the only bytes template parsing acts on.
+        // SSE2/AVX2 when the target has them (/arch:AVX2, -mavx2), scalar otherwise.
+        const char* find_template_special(const char* p, const char* end);
+        const char* find_template_special_scalar(const char* p, const char* end);
+
+        // Formatted argument; integers are rendered into buf, floats like Value, strings are viewed
+        struct StaticPiece {
+            std::string_view text;
+            char buf[Value::kFormatBuffer];
+
+            template <class V>
+            void set(const V& v) {
+                if constexpr (std::is_integral_v<V> && !std::is_same_v<V, bool> && !std::is_same_v<V, char>) {
+                    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+                    text = std::string_view(buf, size_t(r.ptr - buf));
+                }
+                else if constexpr (std::is_floating_point_v<V>) {
+                    text = Value(v).format(buf);
+                }
+                else if constexpr (std::is_same_v<V, Value>) {
+                    text = v.format(buf);
+                }
+                else {
+                    text = std::string_view(v);
+                }
+            }
+        };
+    }
+
+    template <FixedString Source, bool MultiLine = false>
+    struct Template {
+        static constexpr std::string_view source = Source.view();
+        static constexpr size_t op_count = detail::parse_static(source, MultiLine, nullptr);
+        static constexpr std::array<detail::StaticOp, op_count> ops = [] {
+            std::array<detail::StaticOp, op_count> a{};
+            detail::parse_static(source, MultiLine, a.data());
+            return a;
+        }();
+        static constexpr size_t literal_bytes = [] {
+            size_t n = 0;
+            for (const auto& op : ops) if (op.kind == detail::StaticOp::Literal) n += op.length;
+            return n;
+        }();
+        static constexpr size_t line_count = [] {
+            size_t n = 0;
+            for (const auto& op : ops) if (op.kind == detail::StaticOp::EndLine) ++n;
+            return n;
+        }();
+    };
+
+    // Split on LF / CRLF like Writer::lines()
+    template <FixedString Source>
+    using MultiLineTemplate = Template<Source, true>;
+
+    // Named value for a compile-time template: string-like or integral
+    template <FixedString Name, class T>
+    struct Arg {
+        static constexpr std::string_view name = Name.view();
+        const T& value;
+    };
+
+    template <FixedString Name, class T>
+    constexpr Arg<Name, T> arg(const T& value) { return { value }; }
+
+    // ---- Memoized sections ----
+    // Rendered text of named sections, kept across generation runs. Writer::section()
+    // reuses an entry verbatim while its input hash (and indent level) are the ones it
+    // was rendered with, and re-runs the emission code otherwise. Not thread-safe:
+    // one cache per generating thread.
+    class SectionCache {
+    public:
+        struct Stats {
+            size_t hits = 0;
+            size_t misses = 0;
+            size_t bytes_reused = 0;
+        };
+
+        // FNV-1a 64 over the inputs a section depends on: numbers by value, strings with their length
+        template <class... Args>
+        static uint64_t hash_inputs(const Args&... args) {
+            uint64_t h = kHashSeed;
+            (mix(h, args), ...);
+            return h;
+        }
+
+        const Stats& stats() const { return stats_; }
+        void reset_stats() { stats_ = {}; }
+        size_t size() const { return entries_.size(); }
+        void clear() { entries_.clear(); stats_ = {}; }
+
+    private:
+        friend class Writer;
+
+        static constexpr uint64_t kHashSeed = 14695981039346656037ull;
+        static void mix(uint64_t& h, const void* bytes, size_t n) {
+            const unsigned char* p = static_cast<const unsigned char*>(bytes);
+            for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 1099511628211ull; }
+        }
+        static void mix(uint64_t& h, std::string_view s) { const size_t n = s.size(); mix(h, &n, sizeof n); mix(h, s.data(), n); }
+        template <class T> requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+        static void mix(uint64_t& h, T v) { mix(h, &v, sizeof v); }
+
+        struct Entry {
+            uint64_t inputHash = 0;
+            int indentLevel = 0;
+            std::string text;
+            std::vector<size_t> lineStarts;   // relative to text
+        };
+        struct KeyHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+        };
+        const Entry* find(std::string_view key, uint64_t inputHash, int indentLevel);   // counts the hit or miss
+        const Entry& store(std::string_view key, uint64_t inputHash, int indentLevel, std::string_view text);
+
+        std::unordered_map<std::string, Entry, KeyHash, std::equal_to<>> entries_;
+        Stats stats_;
+    };
+
     class Writer {
     public:
-        using Vars = std::unordered_map<std::string, std::string>;
+        // Transparent hashing: find() accepts std::string_view without building a key
+        struct VarsHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+        };
+        // Allocator-aware: Vars vars(&arena) keeps its nodes and strings in that resource
+        using Vars = std::pmr::unordered_map<std::pmr::string, std::pmr::string, VarsHash, std::equal_to<>>;
+
+        // Non-owning view of placeholder values, the parameter type of every
+        // placeholder API. Built from a braced list of typed values (nothing is
+        // copied or allocated: {"INDEX", i}, {"SCALE", 0.5f}, {"NAME", name}) or
+        // from a Vars map. Like std::string_view it must not outlive the call it is
+        // passed to: the braced list and any temporaries in it die at the end of the statement.
+        class VarsView {
+        public:
+            struct Entry {
+                std::string_view key;
+                Value value;
+            };
+
+            VarsView() = default;
+            VarsView(std::initializer_list<Entry> entries) : entries_(std::data(entries)), count_(entries.size()) {}
+            VarsView(const Entry* entries, size_t count) : entries_(entries), count_(count) {}
+            VarsView(const Vars& map) : map_(&map) {}
+
+            // First match wins for duplicate keys, like inserting the list into a map
+            bool find(std::string_view key, Value& value) const {
+                if (map_) {
+                    auto it = map_->find(key);
+                    if (it == map_->end()) return false;
+                    value = std::string_view(it->second);
+                    return true;
+                }
+                for (size_t i = 0; i < count_; ++i) {
+                    if (entries_[i].key == key) { value = entries_[i].value; return true; }
+                }
+                return false;
+            }
+
+            template <class Fn>
+            void for_each_key(Fn&& fn) const {
+                if (map_) { for (const auto& kv : *map_) fn(std::string_view(kv.first)); return; }
+                for (size_t i = 0; i < count_; ++i) fn(entries_[i].key);
+            }
+
+            size_t size() const { return map_ ? map_->size() : count_; }
+
+        private:
+            const Entry* entries_ = nullptr;
+            size_t count_ = 0;
+            const Vars* map_ = nullptr;
+        };
 
         struct ReplaceStats {
+            explicit ReplaceStats(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+                : missing_placeholders(resource), unused_keys(resource) {}
+
             size_t placeholders_found = 0;
             size_t replacements_done = 0;
-            std::vector<std::string> missing_placeholders; // ${...} with no provided value
-            std::vector<std::string> unused_keys;          // provided vars not used
+            std::pmr::vector<std::pmr::string> missing_placeholders; // ${...} with no provided value
+            std::pmr::vector<std::pmr::string> unused_keys;          // provided vars not used
             bool ok(bool require_any) const {
                 if (!missing_placeholders.empty()) return false;
                 if (require_any && replacements_done == 0 && placeholders_found > 0) return false;
@@ -26,48 +377,306 @@ namespace Writer_ {
             }
         };
 
-        explicit Writer(std::string indentUnit = "    ");
+        // Template parsed once into literal spans and placeholder references, so
+        // instantiating it is a straight copy. Immutable; reuse freely across Writers.
+        class CompiledTemplate {
+        public:
+            enum class Mode {
+                SingleLine, // whole text is one line (line/comment)
+                MultiLine   // split on LF / CRLF (lines/comments)
+            };
+
+            // Blocks: ${#each KEY}...${/each} repeats its body per row of a Table value,
+            // ${#if KEY}...${/if} (or ${#if !KEY}) keeps it when the value is truthy; an
+            // absent key is false. In multi-line templates a line holding only a block
+            // tag and whitespace produces no output line. Unbalanced tags are reported
+            // and ignored.
+            CompiledTemplate(std::string source, Mode mode);
+
+            const std::string& source() const { return source_; }
+            Mode mode() const { return mode_; }
+            size_t line_count() const { return line_count_; }        // lines outside of repetition
+            bool has_blocks() const { return has_blocks_; }
+            const std::vector<std::string>& keys() const { return keys_; } // distinct, in first-use order
+
+        private:
+            friend class Writer;
+
+            // Flat program, run once per instantiation
+            struct Op {
+                enum Kind : uint8_t { BeginLine, Literal, Placeholder, EndLine, Each, If, IfNot, EndEach, EndIf };
+                Kind kind;
+                uint32_t offset;  // literal: byte offset into source_, placeholder/opening tag: index into keys_
+                uint32_t length;  // literal: byte count, block tag: index of the matching tag
+            };
+
+            std::string source_;
+            Mode mode_;
+            std::vector<Op> ops_;
+            std::vector<std::string> keys_;
+            size_t literal_bytes_ = 0;
+            size_t line_count_ = 0;
+            uint32_t index_key_ = UINT32_MAX;   // keys_ index of "@index", if used
+            uint32_t each_depth_ = 0;           // deepest nesting of ${#each} blocks
+            bool has_blocks_ = false;
+        };
+
+        // Streaming destination: receives the document in blocks as lines are produced
+        using Sink = std::function<void(std::string_view)>;
+        static Sink ostream_sink(std::ostream& os);               // os must outlive the Writer
+        static Sink fd_sink(int fd);                              // POSIX/CRT descriptor, not closed
+        static Sink file_sink(const std::filesystem::path& filepath); // creates directories, truncates
+
+        static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+        // All storage (text, line index, spliced chunks, indent cache, internal stats) comes
+        // from resource, so a generation run can sit on one std::pmr::monotonic_buffer_resource
+        // and be released at once. The resource must outlive the Writer. Like any pmr
+        // container a copy uses the default resource; a move or child() keeps this one.
+        explicit Writer(std::string_view indentUnit = "    ",
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+        explicit Writer(std::pmr::memory_resource* resource) : Writer("    ", resource) {}
+
+        // Streaming mode: text is handed to sink whenever blockSize bytes are pending
+        // and on flush()/destruction, so memory stays bounded by the block size.
+        // Only the unflushed tail is visible to str()/view()/line_at(); save() is unavailable.
+        // line_at(i) keeps document numbering, so i must be at least flushed_lines().
+        // A copy of a streaming Writer is a plain buffered Writer holding that tail.
+        explicit Writer(Sink sink, std::string_view indentUnit = "    ", size_t blockSize = kDefaultBlockSize,
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+        ~Writer();
+        Writer(const Writer&) = default;
+        Writer& operator=(const Writer&) = default;
+        Writer(Writer&&) = default;
+        Writer& operator=(Writer&&) = default;
 
         // Append primitives
-        void append_raw(const std::string& line);
-        void append(const std::string& line);
-        void line(const std::string& s);
+        void append_raw(std::string_view line);
+        void append(std::string_view line);
+        void line(std::string_view s);
 
         // Single-line with placeholder replacement
-        bool line(const std::string& tmpl, const Vars& vars,
+        bool line(std::string_view tmpl, const VarsView& vars,
             ReplaceStats* outStats = nullptr, bool require_any = true);
 
         // Blank line(s)
         void blank(size_t n = 1);
 
         // Comments
-        void comment(const std::string& s); // single-line, no replacement
-        bool comment(const std::string& tmpl, const Vars& vars,
+        void comment(std::string_view s); // single-line, no replacement
+        bool comment(std::string_view tmpl, const VarsView& vars,
             ReplaceStats* outStats = nullptr, bool require_any = true);
-        bool comments(const std::string& tmplMultiline, const Vars& vars,
+        bool comments(std::string_view tmplMultiline, const VarsView& vars,
             ReplaceStats* outStats = nullptr, bool require_any = true);
 
         // Multi-line content (CR/LF safe)
-        bool lines(const std::string& tmplMultiline, const Vars& vars,
+        bool lines(std::string_view tmplMultiline, const VarsView& vars,
             ReplaceStats* outStats = nullptr, bool require_any = true);
 
+        // Pre-compiled variants (the string overloads above go through a per-thread cache)
+        bool line(const CompiledTemplate& tmpl, const VarsView& vars,
+            ReplaceStats* outStats = nullptr, bool require_any = true);
+        bool lines(const CompiledTemplate& tmpl, const VarsView& vars,
+            ReplaceStats* outStats = nullptr, bool require_any = true);
+
+        // Batch: the (multi-line) template once per row, placeholders taken from the
+        // row's column of the same name, else from shared; ${@index} is the row number.
+        // Parsed once, columns looked up once, output pre-sized from the first row for
+        // all of them, one ReplaceStats for the whole batch. Unused columns are reported.
+        bool lines_batch(std::string_view tmplMultiline, const Table& rows, const VarsView& shared,
+            ReplaceStats* outStats = nullptr, bool require_any = true);
+        bool lines_batch(const CompiledTemplate& tmpl, const Table& rows, const VarsView& shared,
+            ReplaceStats* outStats = nullptr, bool require_any = true);
+        bool lines_batch(std::string_view tmplMultiline, const Table& rows,
+            ReplaceStats* outStats = nullptr, bool require_any = true)
+        {
+            return lines_batch(tmplMultiline, rows, VarsView(), outStats, require_any);
+        }
+
+        // Compile-time checked templates (see Template above)
+        template <FixedString S, bool M, class... Args>
+        void line(Template<S, M> tmpl, const Args&... args) { emit_static(tmpl, "", args...); }
+        template <FixedString S, bool M, class... Args>
+        void comment(Template<S, M> tmpl, const Args&... args) { emit_static(tmpl, "// ", args...); }
+
         // Indentation helpers
-        void open(const std::string& lineWithBrace = "{");
-        void close(const std::string& closingBrace = "}");
+        void open(std::string_view lineWithBrace = "{");
+        void close(std::string_view closingBrace = "}");
 
         // Utilities
         void print() const;
         void write_to(std::ostream& os) const;
+        bool write_to(int fd) const;                          // gathered: one writev per IOV_MAX chunks on POSIX
         void save(const std::filesystem::path& filepath) const;
+
+        // Skip-if-unchanged save for hot-reload consumers: when the file already holds
+        // exactly this document (size check, then streamed compare) nothing is touched.
+        // Otherwise the text goes to a temp file in the same directory that is renamed
+        // over filepath, so readers see either the old or the new file, never a partial one.
+        enum class SaveResult { Written, Unchanged, Failed };
+        SaveResult save_if_changed(const std::filesystem::path& filepath) const;
+        uint64_t content_hash() const;                        // FNV-1a 64 of the buffered document
+
         void clear();
+        void reserve(size_t bytes, size_t lineCount = 0);
         std::string str() const;
-        size_t size()  const { return lines_.size(); }
-        bool   empty() const { return lines_.empty(); }
+        std::string_view view();                              // whole document; merges spliced chunks once
+        std::string_view line_at(size_t i) const;             // without the trailing '\n'; empty if flushed or past the end
+        size_t size()  const { return stream_.flushedLines + sealedLines_ + lineStarts_.size(); }
+        bool   empty() const { return size() == 0; }
+        size_t byte_size() const;                             // buffered bytes, excluding flushed ones
+        std::pmr::memory_resource* resource() const { return text_.get_allocator().resource(); }
+
+        // Visits the buffered document in order as contiguous string_views (one per chunk,
+        // one per run of adjacent pool lines for interned chunks)
+        template <class Fn>
+        void for_each_chunk(Fn&& fn) const {
+            const std::string_view pool(pool_);
+            for (const auto& c : chunks_) {
+                if (!c.interned) { fn(std::string_view(c.text)); continue; }
+                size_t runBegin = 0, runEnd = 0;
+                for (size_t k = 0; k < c.lineStarts.size(); ++k) {
+                    const size_t start = c.lineStarts[k];
+                    if (start != runEnd) {
+                        if (runEnd != runBegin) fn(pool.substr(runBegin, runEnd - runBegin));
+                        runBegin = start;
+                    }
+                    runEnd = start + c.lineLengths[k];
+                }
+                if (runEnd != runBegin) fn(pool.substr(runBegin, runEnd - runBegin));
+            }
+            if (!text_.empty()) fn(std::string_view(text_));
+        }
+
+        // Line interning, for large documents where many lines repeat ("}", "", the same call
+        // at the same indentation): every kDefaultBlockSize bytes the open buffer is compacted
+        // into references to a pool that holds each distinct line once. The document reads
+        // and writes out unchanged; it costs a hash per line, and output goes out in more
+        // pieces. view() expands it again. Buffered Writers only; child() inherits the mode,
+        // and splice() interns a fragment's text.
+        struct InternStats {
+            size_t lines = 0;           // lines compacted into references
+            size_t unique_lines = 0;    // distinct lines stored in the pool
+            size_t logical_bytes = 0;   // bytes those lines stand for
+            size_t pool_bytes = 0;      // bytes the pool holds for them
+            size_t peak_bytes = 0;      // high-water mark of all storage: text, line index, chunks, pool, pool index
+            double dedup_ratio() const { return pool_bytes ? double(logical_bytes) / double(pool_bytes) : 1.0; }
+        };
+        void set_interning(bool on);
+        bool interning() const { return interning_; }
+        InternStats intern_stats() const;             // peak_bytes includes the storage held now
+
+        // Fragments: child() starts an empty buffered Writer with the same indent unit
+        // and the current indent level as its base, to be filled independently (e.g. on
+        // another thread). splice() appends it here by moving its buffers, without
+        // copying lines; splice children in the order their text should appear.
+        Writer child() const;
+        void splice(Writer&& fragment);
 
-        // printf-style but type-safe using std::format
+        // Deferred regions: anchor() marks the current end of the document as a slot to be
+        // filled later, e.g. with declarations only known once the body is written. fill()
+        // moves a fragment's buffers into the slot (a fragment from child(anchor) gets the
+        // anchor's indent level); the document is linked from chunks, so nothing after the
+        // slot is moved. A slot may be filled more than once, in order, or left empty.
+        // view() merges the chunks and clear() drops them: anchors taken before either are
+        // stale, as is one a rollback() cut off. Not available while streaming.
+        struct Anchor {
+            size_t chunk = size_t(-1);
+            int indentLevel = 0;
+            uint32_t epoch = 0;
+            uint32_t slot = 0;
+        };
+        Anchor anchor();
+        Writer child(const Anchor& at) const;
+        bool fill(const Anchor& at, Writer&& fragment);
+
+        // Speculative emission: mark() records the position (chunks, bytes, lines, indent
+        // level) and rollback() truncates back to it in O(1), keeping the capacity, so a
+        // discarded variant costs only the writing. Chunks spliced or anchored after the
+        // mark are dropped; fills of earlier anchors are kept. A mark is stale after view(),
+        // clear(), or a flush of streamed text written since; rollback() then returns false.
+        struct Mark {
+            size_t chunks = 0;
+            size_t bytes = 0;
+            size_t lines = 0;
+            int indentLevel = 0;
+            uint32_t epoch = 0;
+            size_t flushedBytes = 0;
+        };
+        Mark mark() const { return { chunks_.size(), text_.size(), lineStarts_.size(), indentLevel_, chunkEpoch_, stream_.flushedBytes }; }
+        bool rollback(const Mark& at);
+
+        // Memoized section: when cache holds key rendered from the same inputHash at this
+        // indent level, its bytes are appended verbatim and emit is not called; otherwise
+        // emit(Writer&) renders into a child() whose text is stored and then appended.
+        // A null cache just runs emit on *this. Returns true when the cached text was reused.
+        // emit must only write: anything else it does (e.g. drawing random numbers) is skipped on a hit.
+        template <class Fn>
+        bool section(SectionCache* cache, std::string_view key, uint64_t inputHash, Fn&& emit) {
+            if (!cache) { emit(*this); return false; }
+            if (const SectionCache::Entry* hit = cache->find(key, inputHash, indentLevel_)) {
+                append_section(*hit);
+                return true;
+            }
+            Writer fragment = child();
+            emit(fragment);
+            append_section(cache->store(key, inputHash, indentLevel_, fragment.view()));
+            WRITER_METRIC(absorb_metrics(fragment.metrics_, false);)
+            return false;
+        }
+
+        // Streaming
+        bool streaming() const { return static_cast<bool>(stream_.sink); }
+        void flush();                                         // no-op when not streaming
+        size_t flushed_bytes() const { return stream_.flushedBytes; }
+        size_t flushed_lines() const { return stream_.flushedLines; }   // line_at() starts here
+
+        // Instrumentation, per Writer (see WRITER_INSTRUMENTATION). Compiled out,
+        // metrics() returns zeros and to_json() says so.
+        struct Metrics {
+            static constexpr bool enabled = WRITER_INSTRUMENTATION != 0;
+            uint64_t lines = 0;              // including spliced and filled fragments
+            uint64_t bytes = 0;
+            uint64_t template_calls = 0;     // runtime template instantiations (line/lines/comment(s)/lines_batch)
+            uint64_t template_scans = 0;     // template texts scanned for placeholders (compile cache misses)
+            uint64_t placeholders = 0;       // placeholder occurrences met
+            uint64_t replacements = 0;
+            uint64_t misses = 0;             // placeholder occurrences without a value
+            uint64_t allocations = 0;        // growths of the text buffer and line index
+            uint64_t substitution_ns = 0;    // in templates and linef, including streaming flushes they trigger
+            uint64_t io_ns = 0;              // in sinks, write_to, save and save_if_changed
+            std::string to_json() const;     // through CppCommponents/json.h
+        };
+        Metrics metrics() const;
+        void reset_metrics();
+
+        // printf-style but type-safe using std::format; formats straight into the document
         template <class... Args>
-        void linef(std::string_view fmt, Args&&... args) {
-            append(std::vformat(fmt, std::make_format_args(std::forward<Args>(args)...)));
+        void linef(std::format_string<Args...> fmt, Args&&... args) {
+            WRITER_METRIC(MetricsScope timing(metrics_.substitution_ns, substitutionDepth_);)
+            begin_line();
+            std::format_to(std::back_inserter(text_), fmt, std::forward<Args>(args)...);
+            end_line();
+        }
+
+        // Same for a format string only known at run time (std::string, std::string_view,
+        // const char* variables); literals take the overload above and are checked at compile
+        // time. A malformed string is reported and adds no line, as with std::vformat.
+        template <class Fmt, class... Args, std::enable_if_t<
+            std::is_convertible_v<const Fmt&, std::string_view> && !std::is_array_v<std::remove_cvref_t<Fmt>>, int> = 0>
+        void linef(const Fmt& fmt, Args&&... args) {
+            WRITER_METRIC(MetricsScope timing(metrics_.substitution_ns, substitutionDepth_);)
+            const size_t start = text_.size();
+            begin_line();
+            try {
+                std::vformat_to(std::back_inserter(text_), std::string_view(fmt), std::make_format_args(args...));
+            }
+            catch (const std::format_error& e) {
+                drop_failed_line(start, fmt, e.what());
+                return;
+            }
+            end_line();
         }
 
         // RAII indentation scope (alternative to open/close if you dont need braces)
@@ -81,18 +690,252 @@ namespace Writer_ {
         };
 
     private:
+        bool write_file(const std::filesystem::path& filepath) const;
+        void append_section(const SectionCache::Entry& entry);
+
         // Core replacement
-        static std::string replace_placeholders(const std::string& s, const Vars& vars, ReplaceStats& st);
-        static void collect_used_placeholders(const std::string& s, std::unordered_set<std::string>& used);
-        static void report_replace_issue(const char* fn, const std::string& src,
+        const CompiledTemplate& compiled(std::string_view tmpl, CompiledTemplate::Mode mode) const;
+        void instantiate(const CompiledTemplate& t, const VarsView& vars, std::string_view prefix, ReplaceStats& st);
+        struct ResolvedKey { std::string_view text; bool found; char buf[Value::kFormatBuffer]; };
+        void put_placeholder(const CompiledTemplate& t, uint32_t k, const ResolvedKey& value, ReplaceStats& st);
+        void emit_lines(const CompiledTemplate& t, std::string_view prefix, const ResolvedKey* values, ReplaceStats& st);
+        void instantiate_blocks(const CompiledTemplate& t, const VarsView& vars, std::string_view prefix,
+            const ResolvedKey* values, ReplaceStats& st, const Table* rows = nullptr, size_t row = 0);
+        void instantiate_rows(const CompiledTemplate& t, const Table& rows, const VarsView& shared, ReplaceStats& st);
+        static void collect_unused_keys(const CompiledTemplate& t, const VarsView& vars, ReplaceStats& st);
+        static void report_replace_issue(const char* fn, std::string_view src,
             const ReplaceStats& st, bool require_any);
-        static void dedupe_sort(std::vector<std::string>& v);
+        static void dedupe_sort(std::pmr::vector<std::pmr::string>& v);
+
+        template <class T, class... Args>
+        void emit_static(T, std::string_view prefix, const Args&... args);
+
+        // Indent for the current level: a prefix of indentCache_, grown on demand
+        std::string_view indent_prefix() {
+            const size_t n = size_t(indentLevel_) * indentUnit_.size();
+            if (indentCache_.size() < n) grow_indent_cache();
+            return std::string_view(indentCache_.data(), n);
+        }
+        void grow_indent_cache();
+        void grow(size_t bytes, size_t lineCount);  // room for at least this much more
+
+        // Line emission straight into text_: begin_line() records the start and
+        // writes the indent, the caller appends content, end_line() terminates it.
+        void begin_line() { lineStarts_.push_back(text_.size()); text_ += indent_prefix(); }
+        void end_line() {
+            text_.push_back('\n');
+            WRITER_METRIC(note_line(text_.size() - lineStarts_.back(), 1);)
+            if (text_.size() >= blockLimit_) block_full();
+        }
+        void block_full();   // flush when streaming, compact when interning
+        void drop_failed_line(size_t start, std::string_view fmt, const char* error);   // undoes begin_line() for linef
+        size_t blockLimit_ = SIZE_MAX;
+
+        // Streaming state. Copies never stream; a moved-from Writer stops streaming.
+        struct Stream {
+            Sink sink;
+            size_t blockSize = kDefaultBlockSize;
+            size_t flushedLines = 0;
+            size_t flushedBytes = 0;
+
+            Stream() = default;
+            Stream(Sink s, size_t block) : sink(std::move(s)), blockSize(block) {}
+            Stream(const Stream&) {}
+            Stream& operator=(const Stream&) { *this = Stream(); return *this; }
+            Stream(Stream&& o) noexcept { *this = std::move(o); }
+            Stream& operator=(Stream&& o) noexcept {
+                sink = std::move(o.sink); o.sink = nullptr;
+                blockSize = o.blockSize;
+                flushedLines = std::exchange(o.flushedLines, 0);
+                flushedBytes = std::exchange(o.flushedBytes, 0);
+                return *this;
+            }
+        };
 
-        std::string indent_prefix() const;
+        // All lines back to back, each terminated by '\n', so output is one contiguous write
+        std::pmr::string text_;
+        std::pmr::vector<size_t> lineStarts_;
 
-        std::vector<std::string> lines_;
+        // Text spliced in from fragments, in document order before text_
+        struct Chunk {
+            std::pmr::string text;
+            std::pmr::vector<size_t> lineStarts;
+            size_t firstLine = 0;   // index of the chunk's first line among sealed lines
+            uint32_t slot = 0;      // anchor id for a slot, 0 for text
+            bool interned = false;  // lineStarts are offsets of lines in pool_, text is empty
+            size_t bytes = 0;       // document bytes of an interned chunk
+            // Interned: length of each line in pool_, with its '\n'. A line may hold more '\n'
+            // (line("a\nb")), so its end can't be found by searching the pool.
+            std::pmr::vector<size_t> lineLengths{};
+        };
+        std::pmr::vector<Chunk> chunks_;
+        size_t sealedLines_ = 0;
+        uint32_t chunkEpoch_ = 1;    // bumped when view() merges or clear() drops chunks_: anchors and marks go stale
+        uint32_t nextSlot_ = 0;
+        void seal();
+        // lengths is null for plain text, where a line ends where the next starts, and holds the
+        // line lengths when text is the pool and starts are offsets into it
+        using LineLengths = const std::pmr::vector<size_t>*;
+        static std::string_view line_in(std::string_view text, const std::pmr::vector<size_t>& starts, size_t i, LineLengths lengths = nullptr);
+
+        // Each line of a text (pooled: pool, offsets and lengths) with its '\n'
+        template <class Fn>
+        static void visit_lines(std::string_view text, const std::pmr::vector<size_t>& starts, LineLengths lengths, Fn&& fn) {
+            for (size_t i = 0; i < starts.size(); ++i) {
+                const size_t b = starts[i];
+                const size_t e = lengths ? b + (*lengths)[i] : (i + 1 < starts.size() ? starts[i + 1] : text.size());
+                fn(text.substr(b, e - b));
+            }
+        }
+
+        // Interning state: the pool of distinct lines and its index by hash
+        bool interning_ = false;
+        std::pmr::string pool_;
+        std::pmr::unordered_map<size_t, std::pair<size_t, size_t>> poolIndex_;   // hash -> offset, length
+        InternStats internStats_;
+        void intern_block();
+        size_t intern(std::string_view line);   // offset of line (with its '\n') in pool_
+        Chunk interned_chunk(std::string_view text, const std::pmr::vector<size_t>& starts, LineLengths lengths);
+        size_t storage_bytes() const;
         int indentLevel_ = 0;
-        std::string indentUnit_;
+        std::pmr::string indentUnit_;
+        std::pmr::string indentCache_;   // indentUnit_ repeated for the deepest level seen so far
+        Stream stream_;
+
+#if WRITER_INSTRUMENTATION
+        // Adds the scope's wall time to one timer; nested scopes on the same timer count once
+        struct MetricsScope {
+            uint64_t& ns;
+            int& depth;
+            std::chrono::steady_clock::time_point start;
+            MetricsScope(uint64_t& timer, int& nesting) : ns(timer), depth(nesting) {
+                if (depth++ == 0) start = std::chrono::steady_clock::now();
+            }
+            ~MetricsScope() {
+                if (--depth == 0) ns += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            }
+        };
+        void note_line(size_t bytes, size_t lines) {
+            metrics_.lines += lines;
+            metrics_.bytes += bytes;
+            if (text_.capacity() != seenTextCapacity_) { ++metrics_.allocations; seenTextCapacity_ = text_.capacity(); }
+            if (lineStarts_.capacity() != seenLineCapacity_) { ++metrics_.allocations; seenLineCapacity_ = lineStarts_.capacity(); }
+        }
+        void note_template(const ReplaceStats& st) {   // st holds this one call
+            ++metrics_.template_calls;
+            metrics_.placeholders += st.placeholders_found;
+            metrics_.replacements += st.replacements_done;
+            metrics_.misses += st.missing_placeholders.size();
+        }
+        void absorb_metrics(const Metrics& m, bool withLines) {   // a fragment's, when its text joins this one
+            if (withLines) { metrics_.lines += m.lines; metrics_.bytes += m.bytes; }
+            metrics_.template_calls += m.template_calls;
+            metrics_.template_scans += m.template_scans;
+            metrics_.placeholders += m.placeholders;
+            metrics_.replacements += m.replacements;
+            metrics_.misses += m.misses;
+            metrics_.allocations += m.allocations;
+            metrics_.substitution_ns += m.substitution_ns;
+            metrics_.io_ns += m.io_ns;
+        }
+        mutable Metrics metrics_;
+        mutable int substitutionDepth_ = 0;
+        mutable int ioDepth_ = 0;
+        size_t seenTextCapacity_ = 0;
+        size_t seenLineCapacity_ = 0;
+#endif
     };
 
+    namespace detail {
+        template <class... Args>
+        constexpr size_t static_arg_index(std::string_view key) {
+            constexpr std::array<std::string_view, sizeof...(Args)> names{ Args::name... };
+            for (size_t i = 0; i < names.size(); ++i) if (names[i] == key) return i;
+            return size_t(-1);
+        }
+
+        template <class T, class... Args>
+        constexpr bool static_args_cover() {
+            for (const auto& op : T::ops) {
+                if (op.kind == StaticOp::Placeholder &&
+                    static_arg_index<Args...>(T::source.substr(op.offset, op.length)) == size_t(-1)) return false;
+            }
+            return true;
+        }
+
+        template <class T, class... Args>
+        constexpr bool static_args_used() {
+            constexpr std::array<std::string_view, sizeof...(Args)> names{ Args::name... };
+            for (std::string_view name : names) {
+                bool used = false;
+                for (const auto& op : T::ops) {
+                    if (op.kind == StaticOp::Placeholder && T::source.substr(op.offset, op.length) == name) used = true;
+                }
+                if (!used) return false;
+            }
+            return true;
+        }
+
+        template <class T>
+        constexpr bool static_has_no_blocks() {
+            for (const auto& op : T::ops) {
+                if (op.kind != StaticOp::Placeholder || op.length == 0) continue;
+                const char c = T::source[op.offset];
+                if (c == '#' || c == '/' || c == '@') return false;
+            }
+            return true;
+        }
+
+        template <class... Args>
+        constexpr bool static_args_unique() {
+            constexpr std::array<std::string_view, sizeof...(Args)> names{ Args::name... };
+            for (size_t i = 0; i < names.size(); ++i)
+                for (size_t j = i + 1; j < names.size(); ++j)
+                    if (names[i] == names[j]) return false;
+            return true;
+        }
+    }
+
+    template <class T, class... Args>
+    void Writer::emit_static(T, std::string_view prefix, const Args&... args) {
+        static_assert(detail::static_args_cover<T, Args...>(), "Writer template: placeholder without a matching arg<>");
+        static_assert(detail::static_args_used<T, Args...>(), "Writer template: arg<> not used by the template");
+        static_assert(detail::static_args_unique<Args...>(), "Writer template: arg<> given twice");
+        static_assert(detail::static_has_no_blocks<T>(), "Writer template: ${#each}/${#if} blocks need a runtime template");
+        WRITER_METRIC(MetricsScope timing(metrics_.substitution_ns, substitutionDepth_);)
+
+        detail::StaticPiece pieces[sizeof...(Args) + 1];
+        {
+            size_t i = 0;
+            (pieces[i++].set(args.value), ...);
+        }
+
+        size_t bytes = T::literal_bytes + T::line_count * (indent_prefix().size() + prefix.size() + 1);
+        auto measure = [&]<size_t I>() {
+            constexpr detail::StaticOp op = T::ops[I];
+            if constexpr (op.kind == detail::StaticOp::Placeholder) {
+                constexpr size_t index = detail::static_arg_index<Args...>(T::source.substr(op.offset, op.length));
+                bytes += pieces[index].text.size();
+            }
+        };
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (measure.template operator()<I>(), ...);
+        }(std::make_index_sequence<T::op_count>{});
+        grow(bytes, T::line_count);
+
+        auto emit = [&]<size_t I>() {
+            constexpr detail::StaticOp op = T::ops[I];
+            if constexpr (op.kind == detail::StaticOp::BeginLine) { begin_line(); text_ += prefix; }
+            else if constexpr (op.kind == detail::StaticOp::Literal) text_.append(T::source.data() + op.offset, op.length);
+            else if constexpr (op.kind == detail::StaticOp::Placeholder) {
+                constexpr size_t index = detail::static_arg_index<Args...>(T::source.substr(op.offset, op.length));
+                text_ += pieces[index].text;
+            }
+            else end_line();
+        };
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (emit.template operator()<I>(), ...);
+        }(std::make_index_sequence<T::op_count>{});
+    }
+
 } // namespace Writer_
@@ -0,0 +1,689 @@
+#pragma once
+
+#include "ShaderGenerator.h"
+
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include <fstream>
+#include <filesystem>
+#include <memory_resource>
+
+namespace WriterBenchmark {
+
+	// Counted by the global operator new below (this header is the program's main TU)
+	inline std::atomic<size_t> allocations{ 0 };
+
+	struct Result
+	{
+		size_t iterations = 0;
+		size_t lines = 0;
+		size_t bytes = 0;
+		size_t allocations = 0;
+		double seconds = 0.0;
+
+		double lines_per_second() const { return seconds > 0.0 ? double(lines) / seconds : 0.0; }
+		double ns_per_line() const { return lines ? seconds * 1e9 / double(lines) : 0.0; }
+		double mb_per_second() const { return seconds > 0.0 ? double(bytes) / seconds / (1024.0 * 1024.0) : 0.0; }
+		double allocations_per_line() const { return lines ? double(allocations) / double(lines) : 0.0; }
+	};
+
+	// Repeats fn on a fresh Writer until minSeconds have passed. One untimed call first, so the
+	// template cache and the allocator are warm whichever benchmark happens to run first
+	inline Result run(const std::function<void(Writer_::Writer&)>& fn, double minSeconds = 1.0)
+	{
+		using clock = std::chrono::steady_clock;
+
+		{
+			Writer_::Writer w;
+			fn(w);
+		}
+
+		Result r;
+		const size_t allocationsBefore = allocations.load();
+		const auto start = clock::now();
+		do
+		{
+			Writer_::Writer w;
+			fn(w);
+			r.lines += w.size();
+			r.bytes += w.byte_size();
+			++r.iterations;
+			r.seconds = std::chrono::duration<double>(clock::now() - start).count();
+		} while (r.seconds < minSeconds);
+		r.allocations = allocations.load() - allocationsBefore;
+		return r;
+	}
+
+	inline void report(const std::string& name, const Result& r)
+	{
+		std::cout << name
+			<< ": " << r.iterations << " iterations, "
+			<< size_t(r.lines_per_second()) << " lines/s, "
+			<< r.ns_per_line() << " ns/line, "
+			<< r.mb_per_second() << " MB/s, "
+			<< r.allocations_per_line() << " allocs/line\n";
+	}
+
+	// The full generate_shader() workload, seeded so every run emits the same text
+	inline void shader_generator()
+	{
+		Random::set_seed(1);
+		report("shader_generator", run([](Writer_::Writer& w) { write_vertex_shader(w); }));
+
+		if constexpr (Writer_::Writer::Metrics::enabled)
+		{
+			Writer_::Writer w;
+			write_vertex_shader(w);
+			std::cout << "    metrics of one run: " << w.metrics().to_json() << "\n";
+		}
+	}
+
+	// The same with the fixed sections reused from a cache that lives across runs, as main's loop does
+	inline void shader_generator_sections()
+	{
+		Random::set_seed(1);
+		Writer_::SectionCache sections;
+		report("shader_generator_sections", run([&](Writer_::Writer& w) { write_vertex_shader(w, &sections); }));
+	}
+
+	// Only the Wave::write pattern: one template, typed values per line
+	inline void wave_template_lines()
+	{
+		report("wave_template_lines", run([](Writer_::Writer& w) {
+			for (int i = 0; i < 1000; i++)
+			{
+				w.line
+				(
+					"${NAME} += ${NAME}_${INDEX}_${DIRECTION}_amplitude * f_periodic_${PERIODIC_FUNCTION}(f_adjust_to_two_pi(${NAME}_${INDEX}_${DIRECTION}_offset + ${X_OR_Y} * TAU * ${NAME}_${INDEX}_${DIRECTION}_frequency + ${NAME}_${INDEX}_${DIRECTION}_t * uTime));",
+					{
+						{"NAME", "first_wave"},
+						{"INDEX", i},
+						{"DIRECTION", "x"},
+						{"PERIODIC_FUNCTION", i % 11},
+						{"X_OR_Y", "rnd_x"}
+					}
+				);
+			}
+		}));
+	}
+
+	// The same 1000 lines as one ${#each} instantiation over a Table, 20 rows per block like a wave sum
+	inline void wave_template_each()
+	{
+		report("wave_template_each", run([](Writer_::Writer& w) {
+			for (int block = 0; block < 50; block++)
+			{
+				Writer_::Table rows({ "INDEX", "PERIODIC_FUNCTION" });
+				rows.reserve(20);
+				for (int i = 0; i < 20; i++)
+				{
+					rows.add_row({ i, i % 11 });
+				}
+				w.lines
+				(
+					"${#each WAVES}\n"
+					"${NAME} += ${NAME}_${INDEX}_${DIRECTION}_amplitude * f_periodic_${PERIODIC_FUNCTION}(f_adjust_to_two_pi(${NAME}_${INDEX}_${DIRECTION}_offset + ${X_OR_Y} * TAU * ${NAME}_${INDEX}_${DIRECTION}_frequency + ${NAME}_${INDEX}_${DIRECTION}_t * uTime));\n"
+					"${/each}\n",
+					{ {"NAME", "first_wave"}, {"DIRECTION", "x"}, {"X_OR_Y", "rnd_x"}, {"WAVES", rows} }
+				);
+			}
+		}));
+	}
+
+	// The same 1000 lines through lines_batch: the Table is the loop, parsed and sized once per block
+	inline void wave_template_batch()
+	{
+		report("wave_template_batch", run([](Writer_::Writer& w) {
+			for (int block = 0; block < 50; block++)
+			{
+				Writer_::Table rows({ "INDEX", "PERIODIC_FUNCTION" });
+				rows.reserve(20);
+				for (int i = 0; i < 20; i++)
+				{
+					rows.add_row({ i, i % 11 });
+				}
+				w.lines_batch
+				(
+					"${NAME} += ${NAME}_${INDEX}_${DIRECTION}_amplitude * f_periodic_${PERIODIC_FUNCTION}(f_adjust_to_two_pi(${NAME}_${INDEX}_${DIRECTION}_offset + ${X_OR_Y} * TAU * ${NAME}_${INDEX}_${DIRECTION}_frequency + ${NAME}_${INDEX}_${DIRECTION}_t * uTime));",
+					rows,
+					{ {"NAME", "first_wave"}, {"DIRECTION", "x"}, {"X_OR_Y", "rnd_x"} }
+				);
+			}
+		}));
+	}
+
+	// The same with every number converted through std::to_string first
+	inline void wave_template_to_string()
+	{
+		report("wave_template_to_string", run([](Writer_::Writer& w) {
+			for (int i = 0; i < 1000; i++)
+			{
+				w.line
+				(
+					"${NAME} += ${NAME}_${INDEX}_${DIRECTION}_amplitude * f_periodic_${PERIODIC_FUNCTION}(f_adjust_to_two_pi(${NAME}_${INDEX}_${DIRECTION}_offset + ${X_OR_Y} * TAU * ${NAME}_${INDEX}_${DIRECTION}_frequency + ${NAME}_${INDEX}_${DIRECTION}_t * uTime));",
+					{
+						{"NAME", "first_wave"},
+						{"INDEX", std::to_string(i)},
+						{"DIRECTION", "x"},
+						{"PERIODIC_FUNCTION", std::to_string(i % 11)},
+						{"X_OR_Y", "rnd_x"}
+					}
+				);
+			}
+		}));
+	}
+
+	// The linef pattern used for the baked wave constants, nested two levels deep
+	inline void linef_lines()
+	{
+		report("linef_lines", run([](Writer_::Writer& w) {
+			const std::string name = "first_wave";
+			w.open("{");
+			w.open("{");
+			for (int i = 0; i < 1000; i++)
+			{
+				w.linef("float {}_{}_{}_offset = float({});", name, i, "x", float(i) * 0.37f);
+			}
+			w.close("}");
+			w.close("}");
+		}));
+	}
+
+	// Same line through the compile-time Template: no parsing, no key lookup
+	inline void wave_template_static()
+	{
+		report("wave_template_static", run([](Writer_::Writer& w) {
+			const std::string name = "first_wave";
+			for (int i = 0; i < 1000; i++)
+			{
+				w.line
+				(
+					Writer_::Template<"${NAME} += ${NAME}_${INDEX}_${DIRECTION}_amplitude * f_periodic_${PERIODIC_FUNCTION}(f_adjust_to_two_pi(${NAME}_${INDEX}_${DIRECTION}_offset + ${X_OR_Y} * TAU * ${NAME}_${INDEX}_${DIRECTION}_frequency + ${NAME}_${INDEX}_${DIRECTION}_t * uTime));">{},
+					Writer_::arg<"NAME">(name),
+					Writer_::arg<"INDEX">(i),
+					Writer_::arg<"DIRECTION">("x"),
+					Writer_::arg<"PERIODIC_FUNCTION">(i % 11),
+					Writer_::arg<"X_OR_Y">("rnd_x")
+				);
+			}
+		}));
+	}
+
+	// Allocations of the substitution alone: output storage reserved up front, template cached
+	inline void wave_template_allocations()
+	{
+		const char* tmpl = "${NAME} += ${NAME}_${INDEX}_${DIRECTION}_amplitude * f_periodic_${PERIODIC_FUNCTION}(f_adjust_to_two_pi(${NAME}_${INDEX}_${DIRECTION}_offset + ${X_OR_Y} * TAU * ${NAME}_${INDEX}_${DIRECTION}_frequency + ${NAME}_${INDEX}_${DIRECTION}_t * uTime));";
+		const std::string name = "first_wave";
+		const int count = 1000;
+
+		Writer_::Writer w;
+		w.reserve(size_t(count) * 256, count + 1);
+		w.line(tmpl, { {"NAME", name}, {"INDEX", 0}, {"DIRECTION", "x"}, {"PERIODIC_FUNCTION", 0}, {"X_OR_Y", "rnd_x"} });
+
+		const size_t before = allocations.load();
+		for (int i = 0; i < count; i++)
+		{
+			w.line(tmpl, { {"NAME", name}, {"INDEX", i}, {"DIRECTION", "x"}, {"PERIODIC_FUNCTION", i % 11}, {"X_OR_Y", "rnd_x"} });
+		}
+		std::cout << "wave_template_allocations: " << double(allocations.load() - before) / count << " allocs/line\n";
+	}
+
+	// Plain append of pre-built lines: the floor every other case is measured against
+	inline void append_lines()
+	{
+		report("append_lines", run([](Writer_::Writer& w) {
+			w.open("void main()");
+			for (int i = 0; i < 1000; i++)
+			{
+				w.append("gl_Position = uProjection * uView * uModel * vec4(aPos, 1.0);");
+			}
+			w.close("}");
+		}));
+	}
+
+	// Multi-line blocks through lines(): the block shape of the shader's helper functions
+	inline void lines_blocks()
+	{
+		report("lines_blocks", run([](Writer_::Writer& w) {
+			for (int i = 0; i < 200; i++)
+			{
+				w.lines
+				(
+					"float f_periodic_${INDEX}(float x)\n"
+					"{\n"
+					"    float t = f_adjust_to_two_pi(x);\n"
+					"    return ${AMPLITUDE} * sin(t) + ${BIAS};\n"
+					"}\n",
+					{ {"INDEX", "3"}, {"AMPLITUDE", "0.5"}, {"BIAS", "0.25"} }
+				);
+			}
+		}));
+	}
+
+	// Multi-line comments(): same block path plus the "// " prefix
+	inline void comments_blocks()
+	{
+		report("comments_blocks", run([](Writer_::Writer& w) {
+			for (int i = 0; i < 250; i++)
+			{
+				w.comments
+				(
+					"Wave ${NAME}\n"
+					"  amplitude and frequency are baked below\n"
+					"  periodic function ${FUNCTION}\n"
+					"\n",
+					{ {"NAME", "first_wave"}, {"FUNCTION", "f_periodic_3"} }
+				);
+			}
+		}));
+	}
+
+	// Deep open/close nesting: indentation cost dominates
+	inline void open_close()
+	{
+		report("open_close", run([](Writer_::Writer& w) {
+			for (int i = 0; i < 100; i++)
+			{
+				for (int d = 0; d < 8; d++) w.open("{");
+				w.line("x += 1.0;");
+				for (int d = 0; d < 8; d++) w.close("}");
+			}
+		}));
+	}
+
+	// Declarations known only after the body: uniforms collected while 10000 body lines are
+	// written, filled in above them through an anchor, against writing the body into a
+	// second Writer and copying it over once the declarations are out
+	inline void deferred_declarations()
+	{
+		report("deferred_declarations", run([](Writer_::Writer& w) {
+			w.line("#version 450 core");
+			Writer_::Writer::Anchor uniforms = w.anchor();
+			Writer_::Writer decls = w.child(uniforms);
+			for (int i = 0; i < 10000; i++)
+			{
+				w.linef("x += u{} * 2.0;", i);
+				if (i % 100 == 0) decls.linef("uniform float u{};", i);
+			}
+			w.fill(uniforms, std::move(decls));
+		}));
+	}
+
+	inline void deferred_declarations_copy()
+	{
+		report("deferred_declarations_copy", run([](Writer_::Writer& w) {
+			w.line("#version 450 core");
+			Writer_::Writer body = w.child();
+			for (int i = 0; i < 10000; i++)
+			{
+				body.linef("x += u{} * 2.0;", i);
+				if (i % 100 == 0) w.linef("uniform float u{};", i);
+			}
+			for (size_t i = 0; i < body.size(); i++) w.append_raw(body.line_at(i));
+		}));
+	}
+
+	// Search-style generation: 400 candidate blocks of 20 lines, one in four kept. Discarded
+	// ones are rolled back to a mark, against trying each on a copy of the document
+	inline void speculative_rollback()
+	{
+		report("speculative_rollback", run([](Writer_::Writer& w) {
+			for (int i = 0; i < 400; i++)
+			{
+				const Writer_::Writer::Mark mark = w.mark();
+				w.open("{");
+				for (int l = 0; l < 20; l++) w.linef("float v{} = candidate_{}(x);", l, i);
+				w.close("}");
+				if (i % 4 != 0) w.rollback(mark);
+			}
+		}));
+	}
+
+	inline void speculative_copy()
+	{
+		report("speculative_copy", run([](Writer_::Writer& w) {
+			for (int i = 0; i < 400; i++)
+			{
+				Writer_::Writer attempt = w;
+				attempt.open("{");
+				for (int l = 0; l < 20; l++) attempt.linef("float v{} = candidate_{}(x);", l, i);
+				attempt.close("}");
+				if (i % 4 == 0) w = std::move(attempt);
+			}
+		}));
+	}
+
+	// 1M short lines into one Writer, without a reserve()
+	inline void synthetic_1m()
+	{
+		report("synthetic_1m", run([](Writer_::Writer& w) {
+			for (int i = 0; i < 1000000; i++)
+			{
+				w.line("float a = x * 2.0 + b;");
+			}
+		}, 2.0));
+	}
+
+	// A batch of short-lived Writers and Vars maps, as the generator builds them: heap
+	// against one monotonic arena per batch that is released in one go
+	inline void pmr_batch()
+	{
+		auto batch = [](std::pmr::memory_resource* resource, Result& r) {
+			for (int i = 0; i < 1000; i++)
+			{
+				Writer_::Writer::Vars vars(resource);
+				vars["NAME"] = "wave_" + std::to_string(i);
+				vars["DIRECTION"] = i % 2 ? "x" : "y";
+
+				Writer_::Writer w(resource);
+				w.open("{");
+				for (int l = 0; l < 20; l++)
+				{
+					w.line("float ${NAME}_${DIRECTION}_amplitude = 0.5;", vars);
+				}
+				w.close("}");
+				r.lines += w.size();
+				r.bytes += w.byte_size();
+			}
+		};
+
+		auto measure = [&](const std::string& name, auto&& makeResource) {
+			using clock = std::chrono::steady_clock;
+			Result r;
+			const size_t allocationsBefore = allocations.load();
+			const auto start = clock::now();
+			do
+			{
+				makeResource(batch, r);
+				++r.iterations;
+				r.seconds = std::chrono::duration<double>(clock::now() - start).count();
+			} while (r.seconds < 1.0);
+			r.allocations = allocations.load() - allocationsBefore;
+			report(name, r);
+		};
+
+		measure("pmr_batch_heap", [](auto&& batch, Result& r) { batch(std::pmr::new_delete_resource(), r); });
+
+		std::pmr::monotonic_buffer_resource arena(4 * 1024 * 1024);
+		measure("pmr_batch_arena", [&](auto&& batch, Result& r) {
+			batch(&arena, r);
+			arena.release();
+		});
+	}
+
+	// str() on the full shader and on a 1M-line document
+	inline void str_copy()
+	{
+		using clock = std::chrono::steady_clock;
+
+		Random::set_seed(1);
+		Writer_::Writer shader;
+		write_vertex_shader(shader);
+
+		Writer_::Writer large;
+		for (int i = 0; i < 1000000; i++)
+		{
+			large.line("float a = x * 2.0 + b;");
+		}
+
+		auto measure = [&](const std::string& name, const Writer_::Writer& w) {
+			Result r;
+			const size_t allocationsBefore = allocations.load();
+			const auto start = clock::now();
+			do
+			{
+				std::string s = w.str();
+				r.lines += w.size();
+				r.bytes += s.size();
+				++r.iterations;
+				r.seconds = std::chrono::duration<double>(clock::now() - start).count();
+			} while (r.seconds < 1.0);
+			r.allocations = allocations.load() - allocationsBefore;
+			report(name, r);
+		};
+		measure("str_shader", shader);
+		measure("str_1m", large);
+	}
+
+	// Scanner throughput on an 8 KB mostly placeholder-free GLSL block, plus full compilation
+	inline void template_scanning()
+	{
+		using clock = std::chrono::steady_clock;
+
+		std::string block;
+		while (block.size() < 8 * 1024)
+		{
+			block += "float f_periodic(float x)\n{\n    return 0.5 - 0.5 * cos(TAU * x) * abs(fract(x + 0.5) - 0.5) * ${SCALE};\n}\n\n";
+		}
+		const char* begin = block.data();
+		const char* end = begin + block.size();
+
+		auto measure = [&](const char* name, auto&& pass) {
+			size_t passes = 0;
+			size_t hits = 0;
+			const auto start = clock::now();
+			double seconds = 0.0;
+			do
+			{
+				hits += pass();
+				++passes;
+				seconds = std::chrono::duration<double>(clock::now() - start).count();
+			} while (seconds < 0.5);
+			std::cout << name << ": " << double(block.size()) * double(passes) / seconds / (1024.0 * 1024.0) << " MB/s"
+				<< " (" << hits / passes << " per pass)\n";
+		};
+
+		measure("scan_scalar", [&] {
+			size_t hits = 0;
+			for (const char* p = begin; (p = Writer_::detail::find_template_special_scalar(p, end)) != end; ++p) ++hits;
+			return hits;
+		});
+		measure("scan_vectorized", [&] {
+			size_t hits = 0;
+			for (const char* p = begin; (p = Writer_::detail::find_template_special(p, end)) != end; ++p) ++hits;
+			return hits;
+		});
+		measure("compile_template_8k", [&] {
+			Writer_::Writer::CompiledTemplate t(block, Writer_::Writer::CompiledTemplate::Mode::MultiLine);
+			return t.line_count();
+		});
+	}
+
+	// 200k short indented lines, dominated by per-line storage cost
+	inline void large_document()
+	{
+		report("large_document_200k", run([](Writer_::Writer& w) {
+			for (int f = 0; f < 20000; f++)
+			{
+				w.open("float f_generated(float x)");
+				w.line("float a = x * 2.0;");
+				w.line("float b = a + 1.0;");
+				w.line("float c = sin(a) * cos(b);");
+				w.line("float d = c * c;");
+				w.line("float e = sqrt(abs(d));");
+				w.line("return a + b + c + d + e;");
+				w.close("}");
+				w.blank();
+			}
+		}));
+	}
+
+	// 20 generated shaders in one Writer (repetitive, like most generated code), plain and
+	// interned: time, and the dedup ratio and peak storage of the last run
+	inline void interned_document()
+	{
+		for (bool intern : { false, true })
+		{
+			Writer_::Writer::InternStats stats;
+			Random::set_seed(1);
+			const Result r = run([&](Writer_::Writer& w) {
+				w.set_interning(intern);
+				for (int i = 0; i < 20; i++) write_vertex_shader(w);
+				stats = w.intern_stats();
+			});
+			report(intern ? "interned_document" : "plain_document", r);
+			std::cout << "    peak " << stats.peak_bytes << " bytes for " << r.bytes / r.iterations << " document bytes";
+			if (intern) std::cout << ", dedup ratio " << stats.dedup_ratio() << " (" << stats.unique_lines << " distinct of " << stats.lines << " lines)";
+			std::cout << "\n";
+		}
+	}
+
+	// Saving a 1M-line document: the old per-line ofstream loop against the gathered descriptor
+	// save(), once unspliced (one chunk) and once assembled from 256 spliced fragments
+	inline void save_large()
+	{
+		using clock = std::chrono::steady_clock;
+
+		const std::filesystem::path path = std::filesystem::temp_directory_path() / "writer_benchmark_save.txt";
+		auto fill = [](Writer_::Writer& w, int lines) {
+			for (int i = 0; i < lines; i++)
+			{
+				w.linef("float first_wave_{}_x_offset = float({});", i, float(i) * 0.37f);
+			}
+		};
+
+		Writer_::Writer whole;
+		fill(whole, 1000000);
+
+		Writer_::Writer spliced;
+		for (int c = 0; c < 256; c++)
+		{
+			Writer_::Writer part = spliced.child();
+			fill(part, 1000000 / 256);
+			spliced.splice(std::move(part));
+		}
+
+		auto measure = [&](const char* name, const Writer_::Writer& w, auto&& save) {
+			size_t passes = 0;
+			const auto start = clock::now();
+			double seconds = 0.0;
+			do
+			{
+				save(w);
+				++passes;
+				seconds = std::chrono::duration<double>(clock::now() - start).count();
+			} while (seconds < 1.0);
+			std::cout << name << ": " << seconds * 1e3 / double(passes) << " ms/save, "
+				<< double(w.byte_size()) * double(passes) / seconds / (1024.0 * 1024.0) << " MB/s\n";
+		};
+
+		measure("save_ofstream_per_line", whole, [&](const Writer_::Writer& w) {
+			std::ofstream out(path, std::ios::binary);
+			for (size_t i = 0; i < w.size(); i++) out << w.line_at(i) << '\n';
+		});
+		measure("save_ofstream_chunks", whole, [&](const Writer_::Writer& w) {
+			std::ofstream out(path, std::ios::binary);
+			w.write_to(out);
+		});
+		measure("save_vectored", whole, [&](const Writer_::Writer& w) { w.save(path); });
+		measure("save_vectored_spliced", spliced, [&](const Writer_::Writer& w) { w.save(path); });
+
+		std::filesystem::remove(path);
+	}
+
+}
+
+// Every form is replaced, so each pointer goes back to the function family that allocated it:
+// malloc'd blocks to free, aligned ones to _aligned_free on Windows. The sized, array and
+// nothrow deletes forward to the two that free. Those two are kept out of line: inlined,
+// GCC would see free() on a pointer it only knows came from operator new and warn
+// (-Wmismatched-new-delete)
+#if defined(__GNUC__)
+#define WRITER_BENCHMARK_NOINLINE __attribute__((noinline))
+#else
+#define WRITER_BENCHMARK_NOINLINE
+#endif
+
+void* operator new(std::size_t size)
+{
+	++WriterBenchmark::allocations;
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	++WriterBenchmark::allocations;
+	return std::malloc(size ? size : 1);
+}
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+
+// std::pmr::new_delete_resource() allocates through the aligned forms
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+	++WriterBenchmark::allocations;
+	const std::size_t a = static_cast<std::size_t>(align);
+#ifdef _WIN32
+	return _aligned_malloc(size ? size : 1, a);
+#else
+	return std::aligned_alloc(a, (size + a - 1) / a * a);
+#endif
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+	if (void* p = operator new(size, align, std::nothrow)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) { return operator new(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t& tag) noexcept { return operator new(size, align, tag); }
+
+WRITER_BENCHMARK_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { operator delete(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { operator delete(p); }
+
+#ifdef _WIN32
+WRITER_BENCHMARK_NOINLINE void operator delete(void* p, std::align_val_t) noexcept { _aligned_free(p); }
+#else
+WRITER_BENCHMARK_NOINLINE void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+#endif
+void operator delete(void* p, std::size_t, std::align_val_t align) noexcept { operator delete(p, align); }
+void operator delete(void* p, std::align_val_t align, const std::nothrow_t&) noexcept { operator delete(p, align); }
+void operator delete[](void* p, std::align_val_t align) noexcept { operator delete(p, align); }
+void operator delete[](void* p, std::size_t, std::align_val_t align) noexcept { operator delete(p, align); }
+void operator delete[](void* p, std::align_val_t align, const std::nothrow_t&) noexcept { operator delete(p, align); }
+
+int main()
+{
+	std::cout << "WriterBenchmark\n";
+
+	WriterBenchmark::shader_generator();
+	WriterBenchmark::shader_generator_sections();
+	WriterBenchmark::append_lines();
+	WriterBenchmark::wave_template_lines();
+	WriterBenchmark::wave_template_to_string();
+	WriterBenchmark::wave_template_each();
+	WriterBenchmark::wave_template_batch();
+	WriterBenchmark::wave_template_static();
+	WriterBenchmark::lines_blocks();
+	WriterBenchmark::comments_blocks();
+	WriterBenchmark::linef_lines();
+	WriterBenchmark::open_close();
+	WriterBenchmark::deferred_declarations();
+	WriterBenchmark::deferred_declarations_copy();
+	WriterBenchmark::speculative_rollback();
+	WriterBenchmark::speculative_copy();
+	WriterBenchmark::wave_template_allocations();
+	WriterBenchmark::large_document();
+	WriterBenchmark::interned_document();
+	WriterBenchmark::synthetic_1m();
+	WriterBenchmark::str_copy();
+	WriterBenchmark::pmr_batch();
+	WriterBenchmark::template_scanning();
+	WriterBenchmark::save_large();
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "Writer.h"
+#include "SelfCheck.h"
+
+#include <iostream>
+#include <string>
+#include <memory_resource>
+#include <algorithm>
+
+
+
+
+// Regression checks for Writer edge cases: each builds a small document and compares it with
+// the text it must produce. Run by including this header from main.cpp.
+namespace WriterChecks
+{
+	using SelfCheck::Report;
+
+	// A line may carry '\n' of its own; interned, it has to come back whole from every reader
+	static void check_interned_multi_line_values(Report& report)
+	{
+		std::string expected;
+		for (int i = 0; i < 20000; i++) expected += "x\ny\n";
+		expected += "p\nq\nr\n";
+
+		for (bool interning : { false, true })
+		{
+			const std::string tag = interning ? " (interned)" : " (plain)";
+
+			Writer_::Writer w;
+			w.set_interning(interning);
+			for (int i = 0; i < 20000; i++) w.line("x\ny");
+
+			Writer_::Writer child = w.child();
+			child.set_interning(true);
+			child.line("p\nq");
+			child.line("r");
+			w.splice(std::move(child));
+
+			const auto mark = w.mark();
+			w.line("dropped\ndropped");
+			w.rollback(mark);
+
+			report.expect(w.byte_size() == expected.size(), "byte_size" + tag);
+			report.expect(w.line_at(3) == "x\ny", "line_at inside the document" + tag);
+			report.expect(w.line_at(20000) == "p\nq", "line_at of a spliced line" + tag);
+
+			std::string chunks;
+			w.for_each_chunk([&](std::string_view chunk) { chunks += chunk; });
+			report.expect(chunks == expected, "for_each_chunk" + tag);
+
+			Writer_::Writer copy = w;
+			report.expect(std::string(copy.view()) == expected, "view" + tag);
+		}
+	}
+
+	// An unmatched closing tag is dropped without disturbing the lines around it, whether it
+	// stands alone on its line or sits inside one
+	static void check_unmatched_close_tags(Report& report)
+	{
+		struct Case { const char* source; const char* expected; };
+		const Case cases[] =
+		{
+			{ "a ${X}\n${/each}\nb ${Y}\nc", "a 1\nb 2\nc\n" },
+			{ "${/if}\na ${X}\nb ${Y}", "a 1\nb 2\n" },
+			{ "a ${X} ${/each}\nb ${Y}", "a 1 \nb 2\n" },
+			{ "${#if X}\na ${X}\n${/if}\n${/if}\nb ${Y}", "a 1\nb 2\n" },
+			{ "${#each T}\nrow\n${/if}\n${/each}\nb ${Y}", "row\nrow\nb 2\n" },
+		};
+
+		Writer_::Table table({ "I" });
+		table.add_row({ 0 });
+		table.add_row({ 1 });
+
+		for (const Case& c : cases)
+		{
+			Writer_::Writer w;
+			w.lines(c.source, { { "X", 1 }, { "Y", 2 }, { "T", table } });
+			report.expect(w.str() == c.expected, "unmatched close tag in \"" + std::string(c.source) + "\"");
+		}
+	}
+
+	// Cells of an outer ${#each} are rendered once per row and kept while inner blocks open
+	static void check_nested_each(Report& report)
+	{
+		Writer_::Table inner({ "B" });
+		inner.add_row({ 0.25f });
+		inner.add_row({ 7 });
+
+		Writer_::Table outer({ "A", "INNER" });
+		outer.add_row({ 1.5f, inner });
+		outer.add_row({ 2, inner });
+
+		Writer_::Writer w;
+		w.lines("${#each OUTER}\na ${A}\n${#each INNER}\n${A} ${B} ${@index}\n${/each}\n${/each}", { { "OUTER", outer } });
+		report.expect(w.str() == "a 1.5\n1.5 0.25 0\n1.5 7 1\na 2\n2 0.25 0\n2 7 1\n", "nested ${#each}");
+	}
+	// linef takes a compile-time checked literal or, through its runtime overload, any string
+	static void check_linef_runtime_format(Report& report)
+	{
+		const std::string from_file = "vec{} v = vec{}({});";
+		const std::string_view view = "float {} = {};";
+		const char* pointer = "// {}";
+		const std::string bad = "float {} = {;";
+
+		Writer_::Writer w;
+		w.linef("int {} = {};", "i", 3);
+		w.linef(from_file, 3, 3, 0.5f);
+		w.linef(view, "x", 2);
+		w.linef(pointer, "done");
+		w.linef(bad, "y", 1);
+		report.expect(w.str() == "int i = 3;\nvec3 v = vec3(0.5);\nfloat x = 2;\n// done\n", "linef literal, runtime and malformed formats");
+		report.expect(w.size() == 4, "a malformed format adds no line");
+	}
+	// Unformatted floats are the plain shortest to_chars text, as std::format("{}") prints them
+	static void check_float_values(Report& report)
+	{
+		auto text = [](const Writer_::Value& value)
+		{
+			char buf[Writer_::Value::kFormatBuffer];
+			return std::string(value.format(buf));
+		};
+
+		report.expect(text(1234567.f) == "1234567", "float 1234567");
+		report.expect(text(1e-4) == "1e-04", "double 1e-4");
+		report.expect(text(0.1f) == "0.1", "float 0.1");
+		report.expect(text(1e21) == "1e+21", "double 1e21");
+		report.expect(text({ 2.f, { {}, -1, true } }) == "2.0", "decimal_point");
+		report.expect(text({ 3.14159, { std::chars_format::fixed, 2 } }) == "3.14", "fixed, precision 2");
+		report.expect(text({ 1234567.f, { std::chars_format::general, -1, false } }) == "1.234567e+06", "explicit general");
+	}
+
+	// Records the largest single allocation made through it
+	class LargestAllocation : public std::pmr::memory_resource
+	{
+	public:
+		size_t largest = 0;
+
+	private:
+		void* do_allocate(size_t bytes, size_t align) override
+		{
+			largest = std::max(largest, bytes);
+			return std::pmr::new_delete_resource()->allocate(bytes, align);
+		}
+		void do_deallocate(void* p, size_t bytes, size_t align) override { std::pmr::new_delete_resource()->deallocate(p, bytes, align); }
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+	};
+
+	// A streaming Writer holds about a block whatever is written through it; lines_batch's
+	// pre-sizing must not reserve the whole batch
+	static void check_streaming_batch_is_bounded(Report& report)
+	{
+		constexpr size_t block = 4096;
+
+		Writer_::Table rows({ "A", "B" });
+		rows.reserve(200000);
+		for (int i = 0; i < 200000; i++) rows.add_row({ i, i * 0.5f });
+
+		LargestAllocation memory;
+		size_t streamed = 0;
+		{
+			Writer_::Writer w([&](std::string_view text) { streamed += text.size(); }, "    ", block, &memory);
+			w.lines_batch("float v_${@index} = ${A} * ${B};\nv_${@index} += 1.0;", rows, {});
+			w.flush();
+		}
+
+		report.expect(streamed > 200000 * 30, "streamed the whole batch");
+		report.expect(memory.largest <= 4 * block, "largest allocation " + std::to_string(memory.largest) + " bytes, block " + std::to_string(block));
+	}
+
+	// A streaming Writer keeps document line numbers; lines already handed to the sink read as empty
+	static void check_streaming_line_at(Report& report)
+	{
+		Writer_::Writer w([](std::string_view) {}, "    ", 256);
+		for (int i = 0; i < 100; i++) w.line("line " + std::to_string(i));
+
+		const size_t first = w.flushed_lines();
+		report.expect(first > 0 && first < 100, "some lines flushed");
+		report.expect(w.line_at(first) == "line " + std::to_string(first), "first unflushed line");
+		report.expect(w.line_at(99) == "line 99", "last line");
+		report.expect(w.line_at(first - 1).empty(), "flushed line is empty");
+		report.expect(w.line_at(0).empty(), "first line, long flushed, is empty");
+		report.expect(w.line_at(100).empty(), "past the end is empty");
+	}
+}
+
+int main()
+{
+	std::cout << "WriterChecks\n";
+
+	WriterChecks::Report report;
+	WriterChecks::check_interned_multi_line_values(report);
+	WriterChecks::check_unmatched_close_tags(report);
+	WriterChecks::check_nested_each(report);
+	WriterChecks::check_linef_runtime_format(report);
+	WriterChecks::check_float_values(report);
+	WriterChecks::check_streaming_batch_is_bounded(report);
+	WriterChecks::check_streaming_line_at(report);
+
+	std::cout << "  " << report.checks - report.failures << "/" << report.checks << " checks passed\n";
+	return report.failures == 0 ? 0 : 1;
+}
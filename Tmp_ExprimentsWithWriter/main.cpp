@@ -1,5 +1,11 @@
 
 // #include "FindDuplicateImageAndVideos.h"
 
+// #include "WriterBenchmark.h"
+
+// #include "Std140PackingCheck.h"
+
+// #include "WriterChecks.h"
+
 #include "LetGenerateShadersNicely.h"
 